@@ -1,12 +1,23 @@
 // See LICENSE.md
 
+#include <atomic>
 #include <cassert>
+#include <cmath>
 #include <cstddef>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
 
 #include "bignum.h"
+#include "mpn.h"
 
 using ulimb_t = bignum::ulimb_t;
 using udlimb_t = bignum::udlimb_t;
+using limb_buffer = bignum::limb_buffer;
+
+/*! limb vector primitives selected for this host */
+static inline const mpn_ops<ulimb_t>& _mpn() { return mpn_ops<ulimb_t>::get(); }
 
 
 /*--------------.
@@ -59,10 +70,11 @@ bignum::bignum(const bignum &operand)
 	_contract();
 }
 
-/*! move constructor  */
-bignum::bignum(const bignum&& operand) noexcept
+/*! move constructor, leaves operand zero */
+bignum::bignum(bignum &&operand) noexcept
 	: limbs(std::move(operand.limbs)), s(operand.s), bits(operand.bits)
 {
+	operand.limbs.push_back(0);
 	_contract();
 }
 
@@ -89,10 +101,12 @@ bignum& bignum::operator=(const bignum &operand)
 	return *this;
 }
 
-/*! bignum move assignment operator */
+/*! bignum move assignment operator, leaves operand zero */
 bignum& bignum::operator=(bignum &&operand)
 {
+	if (&operand == this) return *this;
 	limbs = std::move(operand.limbs);
+	operand.limbs.push_back(0);
 	if (bits == 0) bits = operand.bits;
 	s = operand.s;
 	return *this;
@@ -115,12 +129,12 @@ void bignum::_contract()
 	while (bits > 0 && num_limbs() > max_limbs()) {
 		limbs.pop_back();
 	}
-	while(num_limbs() > 1 && limbs.back() == 0) {
-		limbs.pop_back();
-	}
 	if (bits > 0 && num_limbs() == max_limbs()) {
 		limbs.back() &= limb_mask(num_limbs() - 1);
 	}
+	while(num_limbs() > 1 && limbs.back() == 0) {
+		limbs.pop_back();
+	}
 }
 
 /*! resize number of limbs */
@@ -129,6 +143,60 @@ void bignum::_resize(size_t n)
 	limbs.resize(n);
 }
 
+/*! copy with capacity for n limbs */
+bignum bignum::_copy(size_t n) const
+{
+	bignum result(s, bits);
+	result.limbs.reserve(std::min(n, max_limbs()));
+	result.limbs.assign(limbs.begin(), limbs.end());
+	return result;
+}
+
+/*! split a 64-bit integer into limbs, returns the significant limb count */
+static size_t _scalar_limbs(uint64_t n, ulimb_t v[2])
+{
+	v[0] = ulimb_t(n);
+	v[1] = bignum::limb_bits < 64 ? ulimb_t(n >> (bignum::limb_bits % 64)) : 0;
+	return v[1] ? 2 : 1;
+}
+
+/*! return the low 64 bits */
+static uint64_t _scalar_value(const bignum &operand)
+{
+	uint64_t n = operand.limb_at(0);
+	if (bignum::limb_bits < 64) n |= uint64_t(operand.limb_at(1)) << (bignum::limb_bits % 64);
+	return n;
+}
+
+/*! assign a 64-bit integer keeping signedness and width */
+bignum& bignum::_assign_ui(uint64_t n)
+{
+	ulimb_t v[2];
+	limbs.assign(v, v + _scalar_limbs(n, v));
+	_contract();
+	return *this;
+}
+
+/*! compare with a negative integer of magnitude mag */
+int bignum::_compare_neg(uint64_t mag) const
+{
+	if (!sign_bit()) return 1;
+	return -(-*this).compare_ui(mag);
+}
+
+/*! negate in two's complement at the width, or at the limbs present for variable width */
+bignum& bignum::_negate_wrap()
+{
+	if (bits > 0) return *this = -std::move(*this);
+	size_t n = num_limbs();
+	for (size_t i = 0; i < n; i++) {
+		limbs[i] = ~limbs[i];
+	}
+	mpn<ulimb_t>::add_1(limbs.data(), limbs.data(), n, 1);
+	_contract();
+	return *this;
+}
+
 
 /*-------------------------------.
 | limb and bit accessor methods. |
@@ -149,7 +217,7 @@ ulimb_t bignum::limb_mask(size_t n) const
     if (bits == 0) return -1;
     if (n < (bits >> limb_shift)) return -1;
     if (n > (bits >> limb_shift)) return 0;
-	else return ((1 << (bits & ((1ULL << limb_bits) - 1))) - 1);
+	else return (ulimb_t(1) << (bits & (limb_bits - 1))) - 1;
 }
 
 /*! test bit at bit offset */
@@ -165,7 +233,7 @@ void bignum::set_bit(size_t n)
 {
 	size_t word = n >> limb_shift;
 	if (word >= num_limbs()) _resize(word + 1);
-	limbs[word] |= (1ULL << (n & (limb_bits-1)));
+	limbs[word] |= (ulimb_t(1) << (n & (limb_bits-1)));
 }
 
 /*! return number of bits */
@@ -191,16 +259,13 @@ bool bignum::sign_bit() const
 bignum& bignum::operator+=(const bignum &operand)
 {
 	_expand(operand);
-	ulimb_t carry = 0;
-	for (size_t i = 0; i < num_limbs(); i++) {
-		ulimb_t old_val = limbs[i];
-		ulimb_t new_val = old_val + operand.limb_at(i) + carry;
-		limbs[i] = new_val;
-		carry = new_val < old_val;
-	}
+	size_t n = std::min(num_limbs(), operand.num_limbs());
+	ulimb_t carry = _mpn().add_n(limbs.data(), limbs.data(), operand.limbs.data(), n);
+	carry = mpn<ulimb_t>::add_1(limbs.data() + n, limbs.data() + n, num_limbs() - n, carry);
 	if (carry && num_limbs() < max_limbs()) {
 		limbs.push_back(1);
 	}
+	_contract();
 	return *this;
 }
 
@@ -208,13 +273,9 @@ bignum& bignum::operator+=(const bignum &operand)
 bignum& bignum::operator-=(const bignum &operand)
 {
 	_expand(operand);
-	ulimb_t borrow = 0;
-	for (size_t i = 0; i < num_limbs(); i++) {
-		ulimb_t old_val = limbs[i];
-		ulimb_t new_val = old_val - operand.limb_at(i) - borrow;
-		limbs[i] = new_val;
-		borrow = new_val > old_val;
-	}
+	size_t n = std::min(num_limbs(), operand.num_limbs());
+	ulimb_t borrow = _mpn().sub_n(limbs.data(), limbs.data(), operand.limbs.data(), n);
+	mpn<ulimb_t>::sub_1(limbs.data() + n, limbs.data() + n, num_limbs() - n, borrow);
 	_contract();
 	return *this;
 }
@@ -230,13 +291,7 @@ bignum& bignum::operator<<=(size_t shamt)
 	_contract();
 	if (!shamt) return *this;
 
-	ulimb_t carry = 0;
-	for (size_t j = 0; j < num_limbs(); j++) {
-		ulimb_t old_val = limbs[j];
-		ulimb_t new_val = (old_val << shamt) | carry;
-		limbs[j] = new_val;
-		carry = old_val >> (limb_bits - shamt);
-	}
+	ulimb_t carry = _mpn().lshift(limbs.data(), limbs.data(), num_limbs(), unsigned(shamt));
 	if (carry && num_limbs() < max_limbs()) {
 		limbs.push_back(carry);
 	}
@@ -257,13 +312,9 @@ bignum& bignum::operator>>=(size_t shamt)
 	}
 	if (!shamt) return *this;
 
-	ulimb_t carry = -(s.is_signed && sign_bit()) << (shamt-1);
-	for (size_t j = num_limbs(); j > 0; j--) {
-		ulimb_t old_val = limbs[j - 1];
-		ulimb_t new_val = (old_val >> shamt) | carry;
-		limbs[j - 1] = new_val;
-		carry = old_val << (limb_bits - shamt);
-	}
+	ulimb_t fill = ulimb_t(-ulimb_t(s.is_signed && sign_bit())) << (shamt-1);
+	_mpn().rshift(limbs.data(), limbs.data(), num_limbs(), unsigned(shamt));
+	limbs.back() |= fill;
 	_contract();
 	return *this;
 }
@@ -306,82 +357,140 @@ bignum& bignum::operator^=(const bignum &operand)
 | const operations. |
 `------------------*/
 
-/* const operations copy and use the mutating operations */
+/*
+ * const operations copy into a result with room for the largest result
+ * and use the mutating operations. The rvalue overloads mutate and move
+ * their left operand, so a chain such as a + b + c allocates at most
+ * once for the first copy.
+ */
 
 /*! add with carry */
-bignum bignum::operator+(const bignum &operand) const
+bignum bignum::operator+(const bignum &operand) const &
 {
-	bignum result(*this);
-	return result += operand;
+	bignum result = _copy(std::max(num_limbs(), operand.num_limbs()) + 1);
+	result += operand;
+	return result;
+}
+
+bignum bignum::operator+(const bignum &operand) &&
+{
+	return std::move(*this += operand);
 }
 
 /*! subtract with borrow */
-bignum bignum::operator-(const bignum &operand) const
+bignum bignum::operator-(const bignum &operand) const &
+{
+	bignum result = _copy(std::max(num_limbs(), operand.num_limbs()));
+	result -= operand;
+	return result;
+}
+
+bignum bignum::operator-(const bignum &operand) &&
 {
-	bignum result(*this);
-	return result -= operand;
+	return std::move(*this -= operand);
 }
 
 /*! left shift */
-bignum bignum::operator<<(size_t shamt) const
+bignum bignum::operator<<(size_t shamt) const &
 {
-	bignum result(*this);
-	return result <<= shamt;
+	bignum result = _copy(num_limbs() + (shamt >> limb_shift) + 1);
+	result <<= shamt;
+	return result;
+}
+
+bignum bignum::operator<<(size_t shamt) &&
+{
+	return std::move(*this <<= shamt);
 }
 
 /*! right shift */
-bignum bignum::operator>>(size_t shamt) const
+bignum bignum::operator>>(size_t shamt) const &
+{
+	bignum result = _copy(num_limbs());
+	result >>= shamt;
+	return result;
+}
+
+bignum bignum::operator>>(size_t shamt) &&
 {
-	bignum result(*this);
-	return result >>= shamt;
+	return std::move(*this >>= shamt);
 }
 
 /*! bitwise and */
-bignum bignum::operator&(const bignum &operand) const
+bignum bignum::operator&(const bignum &operand) const &
 {
-	bignum result(*this);
-	return result &= operand;
+	bignum result = _copy(std::max(num_limbs(), operand.num_limbs()));
+	result &= operand;
+	return result;
+}
+
+bignum bignum::operator&(const bignum &operand) &&
+{
+	return std::move(*this &= operand);
 }
 
 /*! bitwise or */
-bignum bignum::operator|(const bignum &operand) const
+bignum bignum::operator|(const bignum &operand) const &
+{
+	bignum result = _copy(std::max(num_limbs(), operand.num_limbs()));
+	result |= operand;
+	return result;
+}
+
+bignum bignum::operator|(const bignum &operand) &&
 {
-	bignum result(*this);
-	return result |= operand;
+	return std::move(*this |= operand);
 }
 
 /*! bitwise xor */
-bignum bignum::operator^(const bignum &operand) const
+bignum bignum::operator^(const bignum &operand) const &
 {
-	bignum result(*this);
-	return result ^= operand;
+	bignum result = _copy(std::max(num_limbs(), operand.num_limbs()));
+	result ^= operand;
+	return result;
+}
+
+bignum bignum::operator^(const bignum &operand) &&
+{
+	return std::move(*this ^= operand);
 }
 
 /*! bitwise not */
-bignum bignum::operator~() const
+bignum bignum::operator~() const &
 {
-	bignum result(*this);
-	for (auto &n : result.limbs) {
+	return ~_copy(num_limbs());
+}
+
+bignum bignum::operator~() &&
+{
+	for (auto &n : limbs) {
 		n = ~n;
 	}
-	return result;
+	return std::move(*this);
 }
 
 /*! negate */
-bignum bignum::operator-() const
+bignum bignum::operator-() const &
 {
-	bignum result(*this);
 	if (bits == 0) {
-		return result;
+		return *this;
+	}
+	return -_copy(std::max(max_limbs(), num_limbs()));
+}
+
+bignum bignum::operator-() &&
+{
+	if (bits == 0) {
+		return std::move(*this);
 	}
 	size_t n = std::max(max_limbs(), num_limbs());
-	result._resize(n);
-	for (size_t i = 0; i < result.num_limbs(); i++) {
-		result.limbs[i] = ~limb_at(i);
+	_resize(n);
+	for (size_t i = 0; i < n; i++) {
+		limbs[i] = ~limbs[i];
 	}
-	result += 1;
-	result._contract();
-	return result;
+	*this += 1;
+	_contract();
+	return std::move(*this);
 }
 
 
@@ -442,291 +551,2153 @@ bool bignum::operator>=(const bignum &operand) const { return !(*this < operand)
 bool bignum::operator!() const { return *this == 0; }
 
 
-/*--------------------.
-| multply and divide. |
-`--------------------*/
+/*------------------------.
+| multiplication kernels. |
+`------------------------*/
 
-/*! base 2^limb_bits multiply */
-void bignum::mult(const bignum &multiplicand, const bignum multiplier, bignum &result)
+/*
+ * The kernels below operate on little endian limb spans. Products are
+ * written to r which must not overlap the operands, and the recursive
+ * kernels take a scratch area t sized by _mul_itch.
+ */
+
+/*! r[0..an) = a[0..an) + b[0..bn), an >= bn, returns carry */
+static ulimb_t _add(ulimb_t *r, const ulimb_t *a, size_t an, const ulimb_t *b, size_t bn)
 {
-	/* This routine is derived from Hacker's Delight,
-	 * and possibly originates from Knuth */
+	ulimb_t carry = _mpn().add_n(r, a, b, bn);
+	return mpn<ulimb_t>::add_1(r + bn, a + bn, an - bn, carry);
+}
 
-	size_t m = multiplicand.num_limbs(), n = multiplier.num_limbs();
-	size_t k = std::min(multiplicand.max_limbs(), m + n);
-	result._resize(k);
-	ulimb_t carry = 0;
-	udlimb_t mj = multiplier.limbs[0];
-	for (size_t i = 0; i < m && i < k; i++) {
-		udlimb_t t = udlimb_t(multiplicand.limbs[i]) * mj + carry;
-		result.limbs[i] = ulimb_t(t);
-		carry = t >> limb_bits;
-	}
-	if (m < k) {
-		result.limbs[m] = carry;
-	}
+/*! r[0..an) = a[0..an) - b[0..bn), an >= bn, returns borrow */
+static ulimb_t _sub(ulimb_t *r, const ulimb_t *a, size_t an, const ulimb_t *b, size_t bn)
+{
+	ulimb_t borrow = _mpn().sub_n(r, a, b, bn);
+	return mpn<ulimb_t>::sub_1(r + bn, a + bn, an - bn, borrow);
+}
+
+/*! r[0..n) = a[0..n) * c, returns carry */
+static ulimb_t _mul_1(ulimb_t *r, const ulimb_t *a, size_t n, ulimb_t c)
+{
+	return _mpn().mul_1(r, a, n, c);
+}
+
+/*! r[0..n) += a[0..n) * c, returns carry */
+static ulimb_t _addmul_1(ulimb_t *r, const ulimb_t *a, size_t n, ulimb_t c)
+{
+	return _mpn().addmul_1(r, a, n, c);
+}
+
+/*! r[0..m+n) = a[0..m) * b[0..n), schoolbook multiply */
+static void _mul_basecase(ulimb_t *r, const ulimb_t *a, size_t m, const ulimb_t *b, size_t n)
+{
+	r[m] = _mul_1(r, a, m, b[0]);
 	for (size_t j = 1; j < n; j++) {
-		carry = 0;
-		mj = multiplier.limbs[j];
-		for (size_t i = 0; i < m && i + j < k; i++) {
-			udlimb_t t = udlimb_t(multiplicand.limbs[i]) * mj + udlimb_t(result.limbs[i + j]) + carry;
-			result.limbs[i + j] = ulimb_t(t);
-			carry = t >> limb_bits;
-		}
-		if (j + m < k) {
-			result.limbs[j + m] = carry;
-		}
+		r[j + m] = _addmul_1(r + j, a, m, b[j]);
 	}
-	result._contract();
 }
 
-/*! base 2^limb_bits division */
-void bignum::divrem(const bignum &dividend, const bignum &divisor, bignum &quotient, bignum &remainder)
+/*! r[0..n) = a[0..n) << shamt, 0 < shamt < limb_bits, returns bits shifted out */
+static ulimb_t _lshift(ulimb_t *r, const ulimb_t *a, size_t n, unsigned shamt)
 {
-	/* This routine is derived from Hacker's Delight,
-	 * and possibly originates from Knuth */
+	return _mpn().lshift(r, a, n, shamt);
+}
 
-	quotient = 0;
-	remainder = 0;
-	ptrdiff_t m = dividend.num_limbs(), n = divisor.num_limbs();
-	quotient._resize(std::max(m - n + 1, ptrdiff_t(1)));
-	remainder._resize(n);
-	ulimb_t *q = quotient.limbs.data(), *r = remainder.limbs.data();
-	const ulimb_t *u = dividend.limbs.data(), *v = divisor.limbs.data();
+/*! r[0..n) = a[0..n) >> shamt, arithmetic shift of a two's complement span */
+static void _rshift_signed(ulimb_t *r, const ulimb_t *a, size_t n, unsigned shamt)
+{
+	ulimb_t fill = -(a[n - 1] >> (bignum::limb_bits - 1)) << (bignum::limb_bits - shamt);
+	_mpn().rshift(r, a, n, shamt);
+	r[n - 1] |= fill;
+}
 
-	const udlimb_t b = (1ULL << limb_bits); // Number base
-	ulimb_t *un, *vn;                       // Normalized form of u, v.
-	udlimb_t qhat;                          // Estimated quotient digit.
-	udlimb_t rhat;                          // A remainder.
+/*! r[0..n) = -a[0..n), two's complement negate */
+static void _neg(ulimb_t *r, const ulimb_t *a, size_t n)
+{
+	ulimb_t carry = 1;
+	for (size_t i = 0; i < n; i++) {
+		ulimb_t new_val = ~a[i] + carry;
+		carry = new_val < carry;
+		r[i] = new_val;
+	}
+}
 
-	if (m < n || n <= 0 || v[n-1] == 0) {
-		quotient = 0;
-		remainder = dividend;
-		return;
+/*! compare a[0..n) and b[0..n), returns -1, 0 or 1 */
+static int _cmp(const ulimb_t *a, const ulimb_t *b, size_t n)
+{
+	for (size_t i = n; i > 0; i--) {
+		if (a[i - 1] != b[i - 1]) return a[i - 1] < b[i - 1] ? -1 : 1;
 	}
+	return 0;
+}
 
-	// Single digit divisor
-	if (n == 1) {
-		udlimb_t k = 0;
-		for (ptrdiff_t j = m - 1; j >= 0; j--) {
-			q[j] = ulimb_t((k*b + u[j]) / v[0]);
-			k = (k*b + u[j]) - q[j]*v[0];
-		}
-		r[0] = ulimb_t(k);
-		quotient._contract();
-		remainder._contract();
-		return;
+/*! r[0..n) = a[0..n) / d, exact division by odd d using the inverse of d mod 2^limb_bits */
+static void _divexact_1(ulimb_t *r, const ulimb_t *a, size_t n, ulimb_t d)
+{
+	ulimb_t inv = mpn<ulimb_t>::binvert_limb(d);
+	ulimb_t c = 0;
+	for (size_t i = 0; i < n; i++) {
+		ulimb_t s = a[i];
+		ulimb_t l = s - c;
+		c = l > s;
+		ulimb_t q = l * inv;
+		r[i] = q;
+		c += ulimb_t((udlimb_t(q) * d) >> bignum::limb_bits);
 	}
+}
 
-	// Normalize by shifting v left just enough so that
-	// its high-order bit is on, and shift u left the
-	// same amount. We may have to append a high-order
-	// digit on the dividend; we do that unconditionally.
-
-	int s = clz(v[n-1]); // 0 <= s <= limb_bits.
-	vn = (ulimb_t *)alloca(sizeof(ulimb_t) * n);
-	for (ptrdiff_t i = n - 1; i > 0; i--) {
-		vn[i] = (v[i] << s) | (v[i-1] >> (limb_bits-s));
-	}
-	vn[0] = v[0] << s;
-
-	un = (ulimb_t *)alloca(sizeof(ulimb_t) * (m + 1));
-	un[m] = u[m-1] >> (limb_bits-s);
-	for (ptrdiff_t i = m - 1; i > 0; i--) {
-		un[i] = (u[i] << s) | (u[i-1] >> (limb_bits-s));
-	}
-	un[0] = u[0] << s;
-	for (ptrdiff_t j = m - n; j >= 0; j--) { // Main loop.
-		// Compute estimate qhat of q[j].
-		qhat = (un[j+n]*b + un[j+n-1]) / vn[n-1];
-		rhat = (un[j+n]*b + un[j+n-1]) - qhat * vn[n-1];
-	again:
-		if (qhat >= b || qhat*vn[n-2] > b*rhat + un[j+n-2]) {
-			qhat = qhat - 1;
-			rhat = rhat + vn[n-1];
-			if (rhat < b) goto again;
-		}
-		// Multiply and subtract.
-		udlimb_t k = 0;
-		sdlimb_t t = 0;
-		for (ptrdiff_t i = 0; i < n; i++) {
-			unsigned long long p = qhat*vn[i];
-			t = un[i+j] - k - (p & ((1ULL<<limb_bits)-1));
-			un[i+j] = ulimb_t(t);
-			k = (p >> limb_bits) - (t >> limb_bits);
-		}
-		t = un[j+n] - k;
-		un[j+n] = ulimb_t(t);
-
-		q[j] = ulimb_t(qhat); // Store quotient digit.
-		if (t < 0) {         // If we subtracted too
-			q[j] = q[j] - 1; // much, add back.
-			k = 0;
-			for (ptrdiff_t i = 0; i < n; i++) {
-				t = un[i+j] + vn[i] + k;
-				un[i+j] = ulimb_t(t);
-				k = t >> limb_bits;
-			}
-			un[j+n] = ulimb_t(un[j+n] + k);
+/*! r[0..rn) += c * x[0..xn), modulo 2^(limb_bits * rn), xn < rn */
+static void _addmul_small(ulimb_t *r, size_t rn, const ulimb_t *x, size_t xn, ulimb_t c, ulimb_t *t)
+{
+	t[xn] = _mul_1(t, x, xn, c);
+	_add(r, r, rn, t, xn + 1);
+}
+
+/*! r[0..rn) -= c * x[0..xn), modulo 2^(limb_bits * rn), xn < rn */
+static void _submul_small(ulimb_t *r, size_t rn, const ulimb_t *x, size_t xn, ulimb_t c, ulimb_t *t)
+{
+	t[xn] = _mul_1(t, x, xn, c);
+	_sub(r, r, rn, t, xn + 1);
+}
+
+/*! r[0..n) = |a[0..n) - b[0..bn)|, bn <= n, returns true if a < b */
+static bool _sub_abs(ulimb_t *r, const ulimb_t *a, size_t n, const ulimb_t *b, size_t bn)
+{
+	size_t i = n;
+	while (i > bn && a[i - 1] == 0) i--;
+	bool neg = i == bn && _cmp(a, b, bn) < 0;
+	if (neg) {
+		_sub(r, b, bn, a, bn);
+		std::fill(r + bn, r + n, 0);
+	} else {
+		_sub(r, a, n, b, bn);
+	}
+	return neg;
+}
+
+/*! r[0..rn) += x[0..xn) * B^off where the limbs of x beyond rn - off are zero */
+static void _add_at(ulimb_t *r, size_t rn, size_t off, const ulimb_t *x, size_t xn)
+{
+	_add(r + off, r + off, rn - off, x, std::min(xn, rn - off));
+}
+
+/*! r[0..2n) = a[0..n)^2, schoolbook squaring */
+static void _sqr_basecase(ulimb_t *r, const ulimb_t *a, size_t n)
+{
+	/* sum the cross products a[i] * a[j] for i < j once */
+	r[0] = 0;
+	r[2 * n - 1] = 0;
+	if (n > 1) {
+		r[n] = _mul_1(r + 1, a + 1, n - 1, a[0]);
+		for (size_t i = 1; i < n - 1; i++) {
+			r[n + i] = _addmul_1(r + 2 * i + 1, a + i + 1, n - i - 1, a[i]);
 		}
 	}
 
-	// normalize remainder
-	for (ptrdiff_t i = 0; i < n; i++) {
-		r[i] = (un[i] >> s) | (un[i + 1] << (limb_bits - s));
+	/* double them and add the squares on the diagonal */
+	_lshift(r, r, 2 * n, 1);
+	ulimb_t carry = 0;
+	for (size_t i = 0; i < n; i++) {
+		udlimb_t p = udlimb_t(a[i]) * a[i];
+		udlimb_t t = udlimb_t(r[2 * i]) + ulimb_t(p) + carry;
+		r[2 * i] = ulimb_t(t);
+		t = udlimb_t(r[2 * i + 1]) + ulimb_t(p >> bignum::limb_bits) + ulimb_t(t >> bignum::limb_bits);
+		r[2 * i + 1] = ulimb_t(t);
+		carry = ulimb_t(t >> bignum::limb_bits);
 	}
+}
 
-	quotient._contract();
-	remainder._contract();
+static void _mul_n(ulimb_t *r, const ulimb_t *a, const ulimb_t *b, size_t n, ulimb_t *t);
+static void _mul(ulimb_t *r, const ulimb_t *a, size_t m, const ulimb_t *b, size_t n, ulimb_t *t);
+static size_t _mul_fft_itch(size_t m, size_t n);
+static void _sqr_n(ulimb_t *r, const ulimb_t *a, size_t n, ulimb_t *t);
+
+/*! scratch limbs required by _mul_n for two n limb operands */
+static size_t _mul_n_itch(size_t n)
+{
+	if (n < bignum::karatsuba_threshold) {
+		return 0;
+	} else if (n < bignum::toom3_threshold) {
+		size_t l = (n + 1) >> 1;
+		return 4 * (l + 1) + _mul_n_itch(l + 1);
+	} else if (n < bignum::toom4_threshold) {
+		size_t k = (n + 2) / 3;
+		return 4 * (2 * k + 3) + 6 * (k + 1) + _mul_n_itch(k + 1);
+	} else if (n < bignum::fft_threshold) {
+		size_t k = (n + 3) / 4;
+		return 6 * (2 * k + 3) + 11 * (k + 1) + _mul_n_itch(k + 1);
+	} else {
+		return _mul_fft_itch(n, n);
+	}
 }
 
-/*! multiply */
-bignum bignum::operator*(const bignum &operand) const
+/*! scratch limbs required by _mul for m and n limb operands, m >= n */
+static size_t _mul_itch(size_t m, size_t n)
 {
-	bignum result(0, s, bits);
-	mult(*this, operand, result);
-	result._contract();
-	return result;
+	if (n < bignum::karatsuba_threshold) return 0;
+	if (m == n) return _mul_n_itch(n);
+	if (n >= bignum::fft_threshold) return _mul_fft_itch(m, n);
+	return 2 * n + std::max(_mul_n_itch(n), _mul_itch(n, m % n));
 }
 
-/*! division quotient */
-bignum bignum::operator/(const bignum &divisor) const
+/*! scratch limbs required by _sqr_n for an n limb operand */
+static size_t _sqr_n_itch(size_t n)
 {
-	bignum quotient(0, s, bits), remainder(0, s, bits);
-	divrem(*this, divisor, quotient, remainder);
-	return quotient;
+	if (n < bignum::karatsuba_threshold) {
+		return 0;
+	} else if (n < bignum::toom3_threshold) {
+		size_t l = (n + 1) >> 1;
+		return 5 * l + 1 + _sqr_n_itch(l);
+	} else if (n < bignum::toom4_threshold) {
+		size_t k = (n + 2) / 3;
+		return 4 * (2 * k + 3) + 3 * (k + 1) + _sqr_n_itch(k + 1);
+	} else if (n < bignum::fft_threshold) {
+		size_t k = (n + 3) / 4;
+		return 6 * (2 * k + 3) + 6 * (k + 1) + _sqr_n_itch(k + 1);
+	} else {
+		return _mul_fft_itch(n, n);
+	}
 }
 
-/*! division remainder */
-bignum bignum::operator%(const bignum &divisor) const
+/*! r[0..2n) = a[0..n) * b[0..n), karatsuba multiply */
+static void _mul_karatsuba_n(ulimb_t *r, const ulimb_t *a, const ulimb_t *b, size_t n, ulimb_t *t)
 {
-	bignum quotient(0), remainder(0);
-	divrem(*this, divisor, quotient, remainder);
-	return remainder;
+	/*
+	 * a = a1 * B^l + a0, b = b1 * B^l + b0
+	 * a * b = z2 * B^2l + (z1 - z2 - z0) * B^l + z0
+	 * where z0 = a0 * b0, z1 = (a0 + a1) * (b0 + b1), z2 = a1 * b1
+	 */
+	size_t l = (n + 1) >> 1, h = n - l;
+	ulimb_t *sa = t, *sb = t + (l + 1), *z1 = t + 2 * (l + 1), *tt = t + 4 * (l + 1);
+
+	sa[l] = _add(sa, a, l, a + l, h);
+	sb[l] = _add(sb, b, l, b + l, h);
+
+	_mul_n(z1, sa, sb, l + 1, tt);
+	_mul_n(r, a, b, l, tt);
+	_mul_n(r + 2 * l, a + l, b + l, h, tt);
+
+	_sub(z1, z1, 2 * l + 2, r, 2 * l);
+	_sub(z1, z1, 2 * l + 2, r + 2 * l, 2 * h);
+
+	/* z1 < 2 * B^n so limbs above 2n - l are zero */
+	_add(r + l, r + l, 2 * n - l, z1, std::min(2 * l + 2, 2 * n - l));
 }
 
-/*! multiply equals */
-bignum& bignum::operator*=(const bignum &operand)
+/*! r[0..2n) = a[0..n)^2, karatsuba squaring */
+static void _sqr_karatsuba_n(ulimb_t *r, const ulimb_t *a, size_t n, ulimb_t *t)
 {
-	bignum result = *this * operand;
-	*this = std::move(result);
-	return *this;
+	/*
+	 * a = a1 * B^l + a0
+	 * a^2 = z2 * B^2l + (z0 + z2 - z1) * B^l + z0
+	 * where z0 = a0^2, z1 = (a0 - a1)^2, z2 = a1^2
+	 */
+	size_t l = (n + 1) >> 1, h = n - l;
+	ulimb_t *d = t, *z1 = t + l, *z = t + 3 * l, *tt = t + 5 * l + 1;
+
+	_sub_abs(d, a, l, a + l, h);
+	_sqr_n(z1, d, l, tt);
+	_sqr_n(r, a, l, tt);
+	_sqr_n(r + 2 * l, a + l, h, tt);
+
+	z[2 * l] = _add(z, r, 2 * l, r + 2 * l, 2 * h);
+	_sub(z, z, 2 * l + 1, z1, 2 * l);
+	_add(r + l, r + l, 2 * n - l, z, 2 * l + 1);
 }
 
-/*! divide equals */
-bignum& bignum::operator/=(const bignum &operand)
+/*
+ * The Toom-Cook kernels split the operands into 3 or 4 pieces of k limbs
+ * and evaluate them as polynomials at small points. The pointwise products
+ * are kept in 2k + 3 limb two's complement spans so that the interpolation
+ * can work with negative intermediates, using shifts for division by
+ * powers of two and _divexact_1 for the odd constants.
+ */
+
+/*! evaluate a[0..n) split into k limb pieces at 1, -1 and 2 */
+static bool _toom3_eval(ulimb_t *e1, ulimb_t *em1, ulimb_t *e2, const ulimb_t *a, size_t n, size_t k)
 {
-	bignum result = *this / operand;
-	*this = std::move(result);
-	return *this;
+	const ulimb_t *a0 = a, *a1 = a + k, *a2 = a + 2 * k;
+	size_t s = n - 2 * k;
+
+	/* e2 = (2 * a2 + a1) * 2 + a0 */
+	e2[s] = _lshift(e2, a2, s, 1);
+	std::fill(e2 + s + 1, e2 + k + 1, 0);
+	_add(e2, e2, k + 1, a1, k);
+	_lshift(e2, e2, k + 1, 1);
+	_add(e2, e2, k + 1, a0, k);
+
+	/* em1 = |a0 - a1 + a2|, e1 = a0 + a1 + a2 */
+	e1[k] = _add(e1, a0, k, a2, s);
+	bool neg = _sub_abs(em1, e1, k + 1, a1, k);
+	_add(e1, e1, k + 1, a1, k);
+	return neg;
 }
 
-/*! modulus equals */
-bignum& bignum::operator%=(const bignum &operand)
+/*! interpolate the toom3 products and sum them into r[0..2n) */
+static void _toom3_interp(ulimb_t *r, size_t n, size_t k,
+	ulimb_t *v1, ulimb_t *vm1, ulimb_t *v2, ulimb_t *t)
 {
-	bignum result = *this % operand;
-	*this = std::move(result);
-	return *this;
+	const size_t L = 2 * k + 3, s = n - 2 * k;
+	const ulimb_t *c0 = r, *c4 = r + 4 * k;
+
+	/* vm1 = (v1 - vm1) / 2 = c1 + c3, v1 = v1 - vm1 - c0 - c4 = c2 */
+	_sub(vm1, v1, L, vm1, L);
+	_rshift_signed(vm1, vm1, L, 1);
+	_sub(v1, v1, L, vm1, L);
+	_sub(v1, v1, L, c0, 2 * k);
+	_sub(v1, v1, L, c4, 2 * s);
+
+	/* v2 = ((v2 - c0 - 4 * c2 - 16 * c4) / 2 - (c1 + c3)) / 3 = c3 */
+	_sub(v2, v2, L, c0, 2 * k);
+	_submul_small(v2, L, v1, L - 1, 4, t);
+	_submul_small(v2, L, c4, 2 * s, 16, t);
+	_rshift_signed(v2, v2, L, 1);
+	_sub(v2, v2, L, vm1, L);
+	_divexact_1(v2, v2, L, 3);
+
+	/* vm1 = c1 + c3 - c3 = c1 */
+	_sub(vm1, vm1, L, v2, L);
+
+	/* r = c0 + c1 * B^k + c2 * B^2k + c3 * B^3k + c4 * B^4k */
+	std::fill(r + 2 * k, r + 4 * k, 0);
+	_add_at(r, 2 * n, k, vm1, L);
+	_add_at(r, 2 * n, 2 * k, v1, L);
+	_add_at(r, 2 * n, 3 * k, v2, L);
 }
 
+/*! r[0..2n) = a[0..n) * b[0..n), toom-cook 3-way multiply */
+static void _mul_toom3_n(ulimb_t *r, const ulimb_t *a, const ulimb_t *b, size_t n, ulimb_t *t)
+{
+	const size_t k = (n + 2) / 3, s = n - 2 * k, L = 2 * k + 3;
+	ulimb_t *v1 = t, *vm1 = v1 + L, *v2 = vm1 + L, *tmp = v2 + L;
+	ulimb_t *a1 = tmp + L, *am1 = a1 + (k + 1), *a2 = am1 + (k + 1);
+	ulimb_t *b1 = a2 + (k + 1), *bm1 = b1 + (k + 1), *b2 = bm1 + (k + 1);
+	ulimb_t *tt = b2 + (k + 1);
 
-/*--------------------.
-| power via squaring. |
-`--------------------*/
+	bool neg = _toom3_eval(a1, am1, a2, a, n, k);
+	neg ^= _toom3_eval(b1, bm1, b2, b, n, k);
 
-/*! raise to the power */
-bignum bignum::pow(size_t exp) const
-{
-	if (exp == 0) return 1;
-	bignum x = *this, y = 1;
-	while (exp > 1) {
-		if ((exp & 1) == 0) {
-			exp >>= 1;
-		} else {
-			y *= x;
-			exp = (exp - 1) >> 1;
-		}
-		x *= x;
-	}
-	return x * y;
+	_mul_n(v1, a1, b1, k + 1, tt);
+	_mul_n(vm1, am1, bm1, k + 1, tt);
+	_mul_n(v2, a2, b2, k + 1, tt);
+	v1[L - 1] = vm1[L - 1] = v2[L - 1] = 0;
+	if (neg) _neg(vm1, vm1, L);
+
+	_mul_n(r, a, b, k, tt);
+	_mul_n(r + 4 * k, a + 2 * k, b + 2 * k, s, tt);
+
+	_toom3_interp(r, n, k, v1, vm1, v2, tmp);
 }
 
+/*! r[0..2n) = a[0..n)^2, toom-cook 3-way squaring */
+static void _sqr_toom3_n(ulimb_t *r, const ulimb_t *a, size_t n, ulimb_t *t)
+{
+	const size_t k = (n + 2) / 3, s = n - 2 * k, L = 2 * k + 3;
+	ulimb_t *v1 = t, *vm1 = v1 + L, *v2 = vm1 + L, *tmp = v2 + L;
+	ulimb_t *a1 = tmp + L, *am1 = a1 + (k + 1), *a2 = am1 + (k + 1);
+	ulimb_t *tt = a2 + (k + 1);
 
-/*-------------------.
-| string conversion. |
-`-------------------*/
+	_toom3_eval(a1, am1, a2, a, n, k);
 
-/*! helper for recursive divide and conquer conversion to string */
-static inline ptrdiff_t _to_string_c(const bignum &val, std::string &s, ptrdiff_t offset)
+	_sqr_n(v1, a1, k + 1, tt);
+	_sqr_n(vm1, am1, k + 1, tt);
+	_sqr_n(v2, a2, k + 1, tt);
+	v1[L - 1] = vm1[L - 1] = v2[L - 1] = 0;
+
+	_sqr_n(r, a, k, tt);
+	_sqr_n(r + 4 * k, a + 2 * k, s, tt);
+
+	_toom3_interp(r, n, k, v1, vm1, v2, tmp);
+}
+
+/*! evaluate a[0..n) split into k limb pieces at 1, -1, 2, -2 and 1/2 */
+static int _toom4_eval(ulimb_t *e1, ulimb_t *em1, ulimb_t *e2, ulimb_t *em2, ulimb_t *eh,
+	const ulimb_t *a, size_t n, size_t k, ulimb_t *t)
 {
-	udlimb_t v = udlimb_t(val.limb_at(0)) | (udlimb_t(val.limb_at(1)) << bignum::limb_bits);
-	do {
-		s[--offset] = '0' + char(v % 10);
-	} while ((v /= 10) != 0);
-	return offset;
+	const ulimb_t *a0 = a, *a1 = a + k, *a2 = a + 2 * k, *a3 = a + 3 * k;
+	size_t s = n - 3 * k;
+	int neg = 0;
+
+	/* eh = 8 * a0 + 4 * a1 + 2 * a2 + a3 */
+	std::copy(a0, a0 + k, eh);
+	eh[k] = 0;
+	_lshift(eh, eh, k + 1, 1);
+	_add(eh, eh, k + 1, a1, k);
+	_lshift(eh, eh, k + 1, 1);
+	_add(eh, eh, k + 1, a2, k);
+	_lshift(eh, eh, k + 1, 1);
+	_add(eh, eh, k + 1, a3, s);
+
+	/* e1 = (a0 + a2) + (a1 + a3), em1 = |(a0 + a2) - (a1 + a3)| */
+	e1[k] = _add(e1, a0, k, a2, k);
+	e2[k] = _add(e2, a1, k, a3, s);
+	neg |= _sub_abs(em1, e1, k + 1, e2, k + 1);
+	_add(e1, e1, k + 1, e2, k + 1);
+
+	/* e2 = (a0 + 4 * a2) + (2 * a1 + 8 * a3), em2 = |(a0 + 4 * a2) - (2 * a1 + 8 * a3)| */
+	e2[k] = _lshift(e2, a2, k, 2);
+	_add(e2, e2, k + 1, a0, k);
+	em2[s] = _lshift(em2, a3, s, 2);
+	std::fill(em2 + s + 1, em2 + k + 1, 0);
+	_add(em2, em2, k + 1, a1, k);
+	_lshift(em2, em2, k + 1, 1);
+	std::copy(em2, em2 + k + 1, t);
+	neg |= _sub_abs(em2, e2, k + 1, t, k + 1) << 1;
+	_add(e2, e2, k + 1, t, k + 1);
+
+	return neg;
 }
 
-/*! helper for recursive divide and conquer conversion to string */
-static ptrdiff_t _to_string_r(const bignum &val, std::vector<bignum> &sq, size_t level,
-	std::string &s, size_t digits, ptrdiff_t offset)
+/*! interpolate the toom4 products and sum them into r[0..2n) */
+static void _toom4_interp(ulimb_t *r, size_t n, size_t k, ulimb_t *v1, ulimb_t *vm1,
+	ulimb_t *v2, ulimb_t *vm2, ulimb_t *vh, ulimb_t *t)
 {
-	bignum q, r;
-	bignum::divrem(val, sq[level], q, r);
-	if (level > 0) {
-		if (r != 0) {
-			if (q != 0) {
-				_to_string_r(r, sq, level-1, s, digits >> 1, offset);
-				return _to_string_r(q, sq, level-1, s, digits >> 1, offset - digits);
-			} else {
-				return _to_string_r(r, sq, level-1, s, digits >> 1, offset);
-			}
-		}
-	} else {
-		if (r != 0) {
-			if (q != 0) {
-				_to_string_c(r, s, offset);
-				offset = _to_string_c(q, s, offset - digits);
-			} else {
-				offset = _to_string_c(r, s, offset);
-			}
-		}
-	}
-	return offset;
+	const size_t L = 2 * k + 3, s = n - 3 * k;
+	const ulimb_t *c0 = r, *c6 = r + 6 * k;
+
+	/* vm1 = (v1 - vm1) / 2 = O1, v1 = v1 - O1 - c0 - c6 = c2 + c4 */
+	_sub(vm1, v1, L, vm1, L);
+	_rshift_signed(vm1, vm1, L, 1);
+	_sub(v1, v1, L, vm1, L);
+	_sub(v1, v1, L, c0, 2 * k);
+	_sub(v1, v1, L, c6, 2 * s);
+
+	/* vm2 = (v2 - vm2) / 4 = O2, v2 = (v2 - 2 * O2 - c0 - 64 * c6) / 4 = c2 + 4 * c4 */
+	_sub(vm2, v2, L, vm2, L);
+	_rshift_signed(vm2, vm2, L, 2);
+	_submul_small(v2, L, vm2, L - 1, 2, t);
+	_sub(v2, v2, L, c0, 2 * k);
+	_submul_small(v2, L, c6, 2 * s, 64, t);
+	_rshift_signed(v2, v2, L, 2);
+
+	/* v2 = (v2 - v1) / 3 = c4, v1 = v1 - c4 = c2 */
+	_sub(v2, v2, L, v1, L);
+	_divexact_1(v2, v2, L, 3);
+	_sub(v1, v1, L, v2, L);
+
+	/* vh = (vh - 64 * c0 - 16 * c2 - 4 * c4 - c6) / 2 - 16 * O1 */
+	_submul_small(vh, L, c0, 2 * k, 64, t);
+	_submul_small(vh, L, v1, L - 1, 16, t);
+	_submul_small(vh, L, v2, L - 1, 4, t);
+	_sub(vh, vh, L, c6, 2 * s);
+	_rshift_signed(vh, vh, L, 1);
+	_submul_small(vh, L, vm1, L - 1, 16, t);
+
+	/* vm2 = (O2 - O1) / 3 = c3 + 5 * c5, vh = (vh + 12 * vm2) / 45 = c5 */
+	_sub(vm2, vm2, L, vm1, L);
+	_divexact_1(vm2, vm2, L, 3);
+	_addmul_small(vh, L, vm2, L - 1, 12, t);
+	_divexact_1(vh, vh, L, 45);
+
+	/* vm2 = vm2 - 5 * c5 = c3, vm1 = O1 - c3 - c5 = c1 */
+	_submul_small(vm2, L, vh, L - 1, 5, t);
+	_sub(vm1, vm1, L, vm2, L);
+	_sub(vm1, vm1, L, vh, L);
+
+	/* r = c0 + c1 * B^k + c2 * B^2k + c3 * B^3k + c4 * B^4k + c5 * B^5k + c6 * B^6k */
+	std::fill(r + 2 * k, r + 6 * k, 0);
+	_add_at(r, 2 * n, k, vm1, L);
+	_add_at(r, 2 * n, 2 * k, v1, L);
+	_add_at(r, 2 * n, 3 * k, vm2, L);
+	_add_at(r, 2 * n, 4 * k, v2, L);
+	_add_at(r, 2 * n, 5 * k, vh, L);
 }
 
-/*! convert from bignum to string */
-std::string bignum::to_string(size_t radix) const
+/*! r[0..2n) = a[0..n) * b[0..n), toom-cook 4-way multiply */
+static void _mul_toom4_n(ulimb_t *r, const ulimb_t *a, const ulimb_t *b, size_t n, ulimb_t *t)
 {
-	static const char* hexdigits = "0123456789abcdef";
-	static const bignum tenp18{0xa7640000, 0xde0b6b3};
-	static const size_t dgib = 3566893131; /* log2(10) * 1024^3 */
+	const size_t k = (n + 3) / 4, s = n - 3 * k, L = 2 * k + 3;
+	ulimb_t *v1 = t, *vm1 = v1 + L, *v2 = vm1 + L, *vm2 = v2 + L, *vh = vm2 + L, *tmp = vh + L;
+	ulimb_t *a1 = tmp + L, *am1 = a1 + (k + 1), *a2 = am1 + (k + 1), *am2 = a2 + (k + 1), *ah = am2 + (k + 1);
+	ulimb_t *b1 = ah + (k + 1), *bm1 = b1 + (k + 1), *b2 = bm1 + (k + 1), *bm2 = b2 + (k + 1), *bh = bm2 + (k + 1);
+	ulimb_t *tt = bh + (k + 1);
+
+	int neg = _toom4_eval(a1, am1, a2, am2, ah, a, n, k, tt);
+	neg ^= _toom4_eval(b1, bm1, b2, bm2, bh, b, n, k, tt);
+
+	_mul_n(v1, a1, b1, k + 1, tt);
+	_mul_n(vm1, am1, bm1, k + 1, tt);
+	_mul_n(v2, a2, b2, k + 1, tt);
+	_mul_n(vm2, am2, bm2, k + 1, tt);
+	_mul_n(vh, ah, bh, k + 1, tt);
+	v1[L - 1] = vm1[L - 1] = v2[L - 1] = vm2[L - 1] = vh[L - 1] = 0;
+	if (neg & 1) _neg(vm1, vm1, L);
+	if (neg & 2) _neg(vm2, vm2, L);
+
+	_mul_n(r, a, b, k, tt);
+	_mul_n(r + 6 * k, a + 3 * k, b + 3 * k, s, tt);
+
+	_toom4_interp(r, n, k, v1, vm1, v2, vm2, vh, tmp);
+}
 
-	switch (radix) {
-		case 10: {
-			if (*this == 0) return "0";
+/*! r[0..2n) = a[0..n)^2, toom-cook 4-way squaring */
+static void _sqr_toom4_n(ulimb_t *r, const ulimb_t *a, size_t n, ulimb_t *t)
+{
+	const size_t k = (n + 3) / 4, s = n - 3 * k, L = 2 * k + 3;
+	ulimb_t *v1 = t, *vm1 = v1 + L, *v2 = vm1 + L, *vm2 = v2 + L, *vh = vm2 + L, *tmp = vh + L;
+	ulimb_t *a1 = tmp + L, *am1 = a1 + (k + 1), *a2 = am1 + (k + 1), *am2 = a2 + (k + 1), *ah = am2 + (k + 1);
+	ulimb_t *tt = ah + (k + 1);
 
-			/* estimate string length */
-			std::string s;
-			size_t climit = (size_t)(((long long)(num_limbs()) << (limb_shift + 30)) / (long long)dgib) + 1;
-			s.resize(climit, '0');
+	_toom4_eval(a1, am1, a2, am2, ah, a, n, k, tt);
 
-			/* square the chunk size until ~= sqrt(n) */
-			bignum chunk = tenp18;
-			size_t digits = 18;
-			std::vector<bignum> sq = { tenp18 };
-			do {
-				chunk *= chunk;
-				digits <<= 1;
-				sq.push_back(chunk);
-			} while ((chunk.num_limbs() < ((num_limbs() >> 1) + 1)));
+	_sqr_n(v1, a1, k + 1, tt);
+	_sqr_n(vm1, am1, k + 1, tt);
+	_sqr_n(v2, a2, k + 1, tt);
+	_sqr_n(vm2, am2, k + 1, tt);
+	_sqr_n(vh, ah, k + 1, tt);
+	v1[L - 1] = vm1[L - 1] = v2[L - 1] = vm2[L - 1] = vh[L - 1] = 0;
 
-			/* recursively divide by chunk squares */
-			ptrdiff_t offset = _to_string_r(*this, sq, sq.size() - 1, s, digits, climit);
+	_sqr_n(r, a, k, tt);
+	_sqr_n(r + 6 * k, a + 3 * k, s, tt);
 
-			/* return less reserve */
-			return s.substr(offset);
-		}
-		case 2: {
+	_toom4_interp(r, n, k, v1, vm1, v2, vm2, vh, tmp);
+}
+
+/*
+ * The NTT kernel multiplies by convolution of 64-bit coefficients modulo
+ * three primes p = c * 2^40 + 1 below 2^62, using montgomery arithmetic,
+ * and recombines the residues with the chinese remainder theorem. The
+ * primes are ordered p1 < p2 < p3 and their product exceeds 2^185 so the
+ * convolution is exact for transforms of up to 2^40 coefficients.
+ */
+
+/*! 64 x 64 to 128 bit multiply, returns the low word */
+static inline uint64_t _umul64(uint64_t a, uint64_t b, uint64_t *hi)
+{
+#if defined (__SIZEOF_INT128__)
+	unsigned __int128 t = (unsigned __int128)a * b;
+	*hi = uint64_t(t >> 64);
+	return uint64_t(t);
+#elif defined (_MSC_VER) && defined (_M_X64)
+	return _umul128(a, b, hi);
+#else
+	uint64_t al = uint32_t(a), ah = a >> 32, bl = uint32_t(b), bh = b >> 32;
+	uint64_t ll = al * bl, lh = al * bh, hl = ah * bl, hh = ah * bh;
+	uint64_t mid = (ll >> 32) + uint32_t(lh) + uint32_t(hl);
+	*hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+	return (mid << 32) | uint32_t(ll);
+#endif
+}
+
+/*! NTT prime with montgomery constants */
+struct _ntt_prime
+{
+	uint64_t p;    /* prime modulus */
+	uint64_t pinv; /* -p^-1 mod 2^64 */
+	uint64_t r1;   /* 2^64 mod p, montgomery form of 1 */
+	uint64_t r2;   /* 2^128 mod p */
+	uint64_t g;    /* primitive root */
+
+	_ntt_prime(uint64_t p, uint64_t g) : p(p), g(g)
+	{
+		uint64_t inv = p;
+		for (int i = 0; i < 5; i++) {
+			inv *= 2 - p * inv;
+		}
+		pinv = -inv;
+		r1 = (0 - p) % p;
+		r2 = r1;
+		for (int i = 0; i < 64; i++) {
+			r2 = add(r2, r2);
+		}
+	}
+
+	uint64_t add(uint64_t a, uint64_t b) const
+	{
+		uint64_t s = a + b;
+		return s >= p ? s - p : s;
+	}
+
+	uint64_t sub(uint64_t a, uint64_t b) const
+	{
+		return a >= b ? a - b : a + p - b;
+	}
+
+	/*! montgomery multiply, returns a * b / 2^64 mod p */
+	uint64_t mul(uint64_t a, uint64_t b) const
+	{
+		uint64_t hi, lo = _umul64(a, b, &hi);
+		uint64_t mhi, m = lo * pinv;
+		_umul64(m, p, &mhi);
+		uint64_t u = hi + mhi + (lo != 0);
+		return u >= p ? u - p : u;
+	}
+
+	uint64_t to_mont(uint64_t a) const { return mul(a, r2); }
+
+	/*! montgomery exponentiation */
+	uint64_t pow(uint64_t a, uint64_t e) const
+	{
+		uint64_t x = r1;
+		for (; e; e >>= 1) {
+			if (e & 1) x = mul(x, a);
+			a = mul(a, a);
+		}
+		return x;
+	}
+
+	/*! fill tw[len + j] = w^(j * n / 2len) for the n point transform */
+	void twiddle(uint64_t *tw, size_t n, bool inverse) const
+	{
+		uint64_t w = pow(to_mont(g), (p - 1) / n);
+		if (inverse) w = pow(w, p - 2);
+		size_t h = n >> 1;
+		if (h == 0) return;
+		tw[h] = r1;
+		for (size_t j = 1; j < h; j++) {
+			tw[h + j] = mul(tw[h + j - 1], w);
+		}
+		for (size_t len = h >> 1; len >= 1; len >>= 1) {
+			for (size_t j = 0; j < len; j++) {
+				tw[len + j] = tw[2 * len + 2 * j];
+			}
+		}
+	}
+
+	/*! decimation in frequency transform, natural to bit reversed order */
+	void forward(uint64_t *a, size_t n, const uint64_t *tw) const
+	{
+		for (size_t len = n >> 1; len >= 1; len >>= 1) {
+			for (size_t i = 0; i < n; i += 2 * len) {
+				for (size_t j = 0; j < len; j++) {
+					uint64_t u = a[i + j], v = a[i + j + len];
+					a[i + j] = add(u, v);
+					a[i + j + len] = mul(sub(u, v), tw[len + j]);
+				}
+			}
+		}
+	}
+
+	/*! decimation in time inverse transform, bit reversed to natural order */
+	void inverse(uint64_t *a, size_t n, const uint64_t *tw) const
+	{
+		for (size_t len = 1; len < n; len <<= 1) {
+			for (size_t i = 0; i < n; i += 2 * len) {
+				for (size_t j = 0; j < len; j++) {
+					uint64_t u = a[i + j], v = mul(a[i + j + len], tw[len + j]);
+					a[i + j] = add(u, v);
+					a[i + j + len] = sub(u, v);
+				}
+			}
+		}
+	}
+};
+
+enum { _ntt_coeff_limbs = 64 / bignum::limb_bits };
+
+/*! number of 64-bit coefficients for n limbs */
+static size_t _ntt_coeffs(size_t n)
+{
+	return (n + _ntt_coeff_limbs - 1) / _ntt_coeff_limbs;
+}
+
+/*! transform length for m and n limb operands */
+static size_t _ntt_size(size_t m, size_t n)
+{
+	size_t c = _ntt_coeffs(m) + _ntt_coeffs(n) - 1, N = 1;
+	while (N < c) N <<= 1;
+	return N;
+}
+
+/*! load a[0..n) into N 64-bit coefficients reduced modulo p */
+static void _ntt_load(uint64_t *x, size_t N, const ulimb_t *a, size_t n, uint64_t p)
+{
+	size_t c = _ntt_coeffs(n);
+	for (size_t i = 0; i < c; i++) {
+		uint64_t v = 0;
+		for (size_t j = 0; j < _ntt_coeff_limbs; j++) {
+			size_t k = i * _ntt_coeff_limbs + j;
+			if (k < n) v |= uint64_t(a[k]) << (j * bignum::limb_bits);
+		}
+		while (v >= p) v -= p;
+		x[i] = v;
+	}
+	std::fill(x + c, x + N, 0);
+}
+
+/*! scratch limbs required by _mul_fft */
+static size_t _mul_fft_itch(size_t m, size_t n)
+{
+	return (6 * _ntt_size(m, n) + 1) * _ntt_coeff_limbs;
+}
+
+/*! r[0..m+n) = a[0..m) * b[0..n), number theoretic transform multiply */
+static void _mul_fft(ulimb_t *r, const ulimb_t *a, size_t m, const ulimb_t *b, size_t n, ulimb_t *t)
+{
+	static const _ntt_prime q[3] = {
+		_ntt_prime(0x3fff840000000001ULL, 19),
+		_ntt_prime(0x3fffbe0000000001ULL, 3),
+		_ntt_prime(0x3fffc00000000001ULL, 11),
+	};
+
+	const size_t N = _ntt_size(m, n);
+	uint64_t *x = (uint64_t*)(void*)(((uintptr_t)t + 7) & ~uintptr_t(7));
+	uint64_t *y = x + 3 * N, *tw = y + N, *itw = tw + N;
+
+	/* convolution modulo each prime, scaled by 1/N in the pointwise step */
+	for (size_t k = 0; k < 3; k++) {
+		const _ntt_prime &p = q[k];
+		uint64_t *z = x + k * N;
+		uint64_t scale = p.to_mont(p.to_mont(p.p - (p.p - 1) / N));
+		p.twiddle(tw, N, false);
+		p.twiddle(itw, N, true);
+		_ntt_load(z, N, a, m, p.p);
+		p.forward(z, N, tw);
+		if (a == b && m == n) {
+			for (size_t i = 0; i < N; i++) {
+				z[i] = p.mul(p.mul(z[i], z[i]), scale);
+			}
+		} else {
+			_ntt_load(y, N, b, n, p.p);
+			p.forward(y, N, tw);
+			for (size_t i = 0; i < N; i++) {
+				z[i] = p.mul(p.mul(z[i], y[i]), scale);
+			}
+		}
+		p.inverse(z, N, itw);
+	}
+
+	/* garner recombination: x = x1 + x2 * p1 + x3 * p1 * p2 */
+	const uint64_t c12 = q[1].pow(q[1].to_mont(q[0].p), q[1].p - 2);
+	const uint64_t c13 = q[2].pow(q[2].to_mont(q[0].p), q[2].p - 2);
+	const uint64_t c23 = q[2].pow(q[2].to_mont(q[1].p), q[2].p - 2);
+	uint64_t p12hi, p12lo = _umul64(q[0].p, q[1].p, &p12hi);
+	uint64_t acc0 = 0, acc1 = 0, acc2 = 0;
+	size_t rn = m + n;
+	for (size_t i = 0; i * _ntt_coeff_limbs < rn; i++) {
+		uint64_t x1 = 0, x2 = 0, x3 = 0, hi, lo, c;
+		if (i < N) {
+			x1 = x[i];
+			x2 = q[1].mul(q[1].sub(x[N + i], x1), c12);
+			x3 = q[2].mul(q[2].sub(q[2].mul(q[2].sub(x[2 * N + i], x1), c13), x2), c23);
+		}
+
+		/* acc += x1 + x2 * p1 */
+		lo = _umul64(x2, q[0].p, &hi);
+		lo += x1; hi += lo < x1;
+		acc0 += lo; c = acc0 < lo;
+		acc1 += hi; acc2 += acc1 < hi;
+		acc1 += c; acc2 += acc1 < c;
+
+		/* acc += x3 * p1 * p2 */
+		lo = _umul64(x3, p12lo, &hi);
+		acc0 += lo; c = acc0 < lo;
+		acc1 += hi; acc2 += acc1 < hi;
+		acc1 += c; acc2 += acc1 < c;
+		lo = _umul64(x3, p12hi, &hi);
+		acc1 += lo; acc2 += (acc1 < lo) + hi;
+
+		for (size_t j = 0; j < _ntt_coeff_limbs; j++) {
+			size_t k = i * _ntt_coeff_limbs + j;
+			if (k < rn) r[k] = ulimb_t(acc0 >> (j * bignum::limb_bits));
+		}
+		acc0 = acc1; acc1 = acc2; acc2 = 0;
+	}
+}
+
+/*! r[0..2n) = a[0..n) * b[0..n), selects algorithm by size */
+static void _mul_n(ulimb_t *r, const ulimb_t *a, const ulimb_t *b, size_t n, ulimb_t *t)
+{
+	if (n < bignum::karatsuba_threshold) {
+		_mul_basecase(r, a, n, b, n);
+	} else if (n < bignum::toom3_threshold) {
+		_mul_karatsuba_n(r, a, b, n, t);
+	} else if (n < bignum::toom4_threshold) {
+		_mul_toom3_n(r, a, b, n, t);
+	} else if (n < bignum::fft_threshold) {
+		_mul_toom4_n(r, a, b, n, t);
+	} else {
+		_mul_fft(r, a, n, b, n, t);
+	}
+}
+
+/*! r[0..2n) = a[0..n)^2, selects algorithm by size */
+static void _sqr_n(ulimb_t *r, const ulimb_t *a, size_t n, ulimb_t *t)
+{
+	if (n < bignum::karatsuba_threshold) {
+		_sqr_basecase(r, a, n);
+	} else if (n < bignum::toom3_threshold) {
+		_sqr_karatsuba_n(r, a, n, t);
+	} else if (n < bignum::toom4_threshold) {
+		_sqr_toom3_n(r, a, n, t);
+	} else if (n < bignum::fft_threshold) {
+		_sqr_toom4_n(r, a, n, t);
+	} else {
+		_mul_fft(r, a, n, a, n, t);
+	}
+}
+
+/*! r[0..m+n) = a[0..m) * b[0..n), m >= n */
+static void _mul(ulimb_t *r, const ulimb_t *a, size_t m, const ulimb_t *b, size_t n, ulimb_t *t)
+{
+	if (n < bignum::karatsuba_threshold) {
+		_mul_basecase(r, a, m, b, n);
+		return;
+	}
+	if (m == n) {
+		_mul_n(r, a, b, n, t);
+		return;
+	}
+	if (n >= bignum::fft_threshold) {
+		_mul_fft(r, a, m, b, n, t);
+		return;
+	}
+
+	/* unbalanced operands are multiplied in n limb slices of a */
+	ulimb_t *p = t, *tt = t + 2 * n;
+	_mul_n(r, a, b, n, tt);
+	for (size_t i = n; i < m; i += n) {
+		size_t k = std::min(n, m - i);
+		if (k == n) {
+			_mul_n(p, a + i, b, n, tt);
+		} else {
+			_mul(p, b, n, a + i, k, tt);
+		}
+		ulimb_t carry = _add(r + i, r + i, n, p, n);
+		_add(r + i + n, p + n, k, &carry, 1);
+	}
+}
+
+/*------------------.
+| division kernels. |
+`------------------*/
+
+/*
+ * The kernels below divide n[0..nn) by a normalized divisor d[0..dn),
+ * one with the top bit of d[dn-1] set. The quotient is written to
+ * q[0..nn-dn) with the high quotient limb (0 or 1) returned, and the
+ * remainder is left in n[0..dn). Divide and conquer division follows
+ * Burnikel and Ziegler as arranged in GMP's dcpi1 routines: the top
+ * half of the quotient is found recursively from the top half of the
+ * divisor and then corrected with a multiplication by the low half.
+ * Every sub-divisor shares the top limb of d, so the quotient limb
+ * estimates all use the one reciprocal dinv = invert_limb(d[dn-1]).
+ */
+
+/*! q[0..nn-dn) = n[0..nn) / d[0..dn), schoolbook division, dn >= 2 */
+static ulimb_t _div_qr_basecase(ulimb_t *q, ulimb_t *n, size_t nn, const ulimb_t *d, size_t dn, ulimb_t dinv)
+{
+	/* This routine is derived from Hacker's Delight,
+	 * and possibly originates from Knuth */
+
+	const udlimb_t b = udlimb_t(1) << bignum::limb_bits;
+	const ulimb_t d1 = d[dn - 1], d0 = d[dn - 2];
+
+	ulimb_t qh = _cmp(n + nn - dn, d, dn) >= 0;
+	if (qh) {
+		_mpn().sub_n(n + nn - dn, n + nn - dn, d, dn);
+	}
+
+	for (size_t j = nn - dn; j-- > 0; ) {
+		// Compute estimate qhat of q[j] using the reciprocal of d1.
+		ulimb_t n1 = n[j + dn], n0 = n[j + dn - 1];
+		udlimb_t qhat, rhat;
+		if (n1 == d1) {
+			qhat = b - 1;
+			rhat = udlimb_t(n0) + d1;
+		} else {
+			ulimb_t r;
+			qhat = mpn<ulimb_t>::div_preinv(n1, n0, d1, dinv, &r);
+			rhat = r;
+		}
+		while (rhat < b && qhat * d0 > ((rhat << bignum::limb_bits) | n[j + dn - 2])) {
+			qhat = qhat - 1;
+			rhat = rhat + d1;
+		}
+
+		// Multiply and subtract, adding back if we subtracted too much.
+		ulimb_t borrow = _mpn().submul_1(n + j, d, dn, ulimb_t(qhat));
+		ulimb_t top = n[j + dn];
+		n[j + dn] = top - borrow;
+		if (top < borrow) {
+			qhat = qhat - 1;
+			n[j + dn] += _mpn().add_n(n + j, n + j, d, dn);
+		}
+		q[j] = ulimb_t(qhat);
+	}
+	return qh;
+}
+
+/*! scratch limbs required by _div_qr_n for an n limb divisor */
+static size_t _div_qr_n_itch(size_t n)
+{
+	if (n < bignum::div_dc_threshold) return 0;
+	size_t lo = n >> 1, hi = n - lo;
+	return std::max(n + _mul_itch(hi, lo), _div_qr_n_itch(hi));
+}
+
+/*! q[0..n) = n[0..2n) / d[0..n), divide and conquer division */
+static ulimb_t _div_qr_n(ulimb_t *q, ulimb_t *np, const ulimb_t *d, size_t n, ulimb_t dinv, ulimb_t *t)
+{
+	if (n < bignum::div_dc_threshold) {
+		return _div_qr_basecase(q, np, 2 * n, d, n, dinv);
+	}
+
+	size_t lo = n >> 1, hi = n - lo;
+	ulimb_t cy, qh, ql;
+
+	/* high half of the quotient from the high half of the divisor */
+	qh = _div_qr_n(q + lo, np + 2 * lo, d + lo, hi, dinv, t);
+	_mul(t, q + lo, hi, d, lo, t + n);
+	cy = _mpn().sub_n(np + lo, np + lo, t, n);
+	if (qh) {
+		cy += _mpn().sub_n(np + n, np + n, d, lo);
+	}
+	while (cy) {
+		qh -= mpn<ulimb_t>::sub_1(q + lo, q + lo, hi, 1);
+		cy -= _mpn().add_n(np + lo, np + lo, d, n);
+	}
+
+	/* low half of the quotient from the partial remainder */
+	ql = _div_qr_n(q, np + hi, d + hi, lo, dinv, t);
+	_mul(t, d, hi, q, lo, t + n);
+	cy = _mpn().sub_n(np, np, t, n);
+	if (ql) {
+		cy += _mpn().sub_n(np + lo, np + lo, d, hi);
+	}
+	while (cy) {
+		mpn<ulimb_t>::sub_1(q, q, lo, 1);
+		cy -= _mpn().add_n(np, np, d, n);
+	}
+
+	return qh;
+}
+
+/*! size of the leading quotient block of _div_qr, 0 < qn <= dn */
+static size_t _div_qr_block(size_t nn, size_t dn)
+{
+	size_t qn = nn - dn;
+	return qn - ((qn - 1) / dn) * dn;
+}
+
+/*! scratch limbs required by _div_qr for an nn limb dividend and dn limb divisor */
+static size_t _div_qr_itch(size_t nn, size_t dn)
+{
+	if (dn < bignum::div_dc_threshold || nn - dn < bignum::div_dc_threshold) return 0;
+	size_t qn = _div_qr_block(nn, dn);
+	size_t itch = _div_qr_n_itch(dn);
+	if (qn >= bignum::div_dc_threshold && qn != dn) {
+		itch = std::max(itch, _div_qr_n_itch(qn));
+		itch = std::max(itch, dn + _mul_itch(std::max(qn, dn - qn), std::min(qn, dn - qn)));
+	}
+	return itch;
+}
+
+/*! q[0..nn-dn) = n[0..nn) / d[0..dn), nn >= dn >= 2 */
+static ulimb_t _div_qr(ulimb_t *q, ulimb_t *np, size_t nn, const ulimb_t *d, size_t dn, ulimb_t dinv, ulimb_t *t)
+{
+	if (dn < bignum::div_dc_threshold || nn - dn < bignum::div_dc_threshold) {
+		return _div_qr_basecase(q, np, nn, d, dn, dinv);
+	}
+
+	/* the leading block takes the odd quotient limbs, point at its low end */
+	size_t qn = _div_qr_block(nn, dn), rn = nn - dn - qn;
+	ulimb_t *qp = q + rn, *p = np + rn;
+	ulimb_t qh, cy;
+
+	if (qn < bignum::div_dc_threshold) {
+		qh = _div_qr_basecase(qp, p, dn + qn, d, dn, dinv);
+	} else {
+		/* divide by the high qn limbs of d then correct with the rest */
+		qh = _div_qr_n(qp, p + dn - qn, d + dn - qn, qn, dinv, t);
+		if (qn != dn) {
+			if (qn > dn - qn) {
+				_mul(t, qp, qn, d, dn - qn, t + dn);
+			} else {
+				_mul(t, d, dn - qn, qp, qn, t + dn);
+			}
+			cy = _mpn().sub_n(p, p, t, dn);
+			if (qh) {
+				cy += _mpn().sub_n(p + qn, p + qn, d, dn - qn);
+			}
+			while (cy) {
+				qh -= mpn<ulimb_t>::sub_1(qp, qp, qn, 1);
+				cy -= _mpn().add_n(p, p, d, dn);
+			}
+		}
+	}
+
+	/* the remaining blocks each divide 2dn limbs of partial remainder */
+	while (rn > 0) {
+		rn -= dn;
+		_div_qr_n(q + rn, np + rn, d, dn, dinv, t);
+	}
+	return qh;
+}
+
+/*! scratch limbs required by _divrem_norm for an m limb dividend and n limb divisor */
+static size_t _divrem_norm_itch(size_t m, size_t n)
+{
+	return m + 1 + _div_qr_itch(m + 1, n);
+}
+
+/*! q[0..m-n] = u[0..m) / v, r[0..n) = u[0..m) % v, for vn[0..n) = v << s normalized,
+ *  using _divrem_norm_itch(m, n) limbs of scratch at un */
+static void _divrem_norm(ulimb_t *q, ulimb_t *r, const ulimb_t *u, size_t m,
+	const ulimb_t *vn, size_t n, int s, ulimb_t dinv, ulimb_t *un)
+{
+	// Shift u left by the divisor normalization. We may have to
+	// append a high-order digit on the dividend; we do that
+	// unconditionally.
+
+	// The copy is taken before q and r are written, so either
+	// may alias u.
+
+	std::copy(u, u + m, un);
+	un[m] = s ? _mpn().lshift(un, u, m, s) : 0;
+
+	// The appended digit is less than vn[n-1] so the high
+	// quotient digit is always zero.
+	_div_qr(q, un, m + 1, vn, n, dinv, un + m + 1);
+
+	// normalize remainder
+	if (s) {
+		_mpn().rshift(r, un, n, s);
+	} else {
+		std::copy(un, un + n, r);
+	}
+}
+
+/*! q[0..m-n] = u[0..m) / v, r[0..n) = u[0..m) % v, for vn[0..n) = v << s normalized */
+static void _divrem_norm(ulimb_t *q, ulimb_t *r, const ulimb_t *u, size_t m,
+	const ulimb_t *vn, size_t n, int s, ulimb_t dinv)
+{
+	limb_buffer un(_divrem_norm_itch(m, n));
+	_divrem_norm(q, r, u, m, vn, n, s, dinv, un.data());
+}
+
+/*--------------------.
+| multply and divide. |
+`--------------------*/
+
+/*! base 2^limb_bits multiply */
+void bignum::mult(const bignum &multiplicand, const bignum &multiplier, bignum &result)
+{
+	if (&result == &multiplicand || &result == &multiplier) {
+		bignum tmp(0, result.s, result.bits);
+		mult(multiplicand, multiplier, tmp);
+		result = std::move(tmp);
+		return;
+	}
+
+	if (&multiplicand == &multiplier) {
+		sqr(multiplicand, result);
+		return;
+	}
+
+	size_t m = multiplicand.num_limbs(), n = multiplier.num_limbs();
+	size_t k = std::min(multiplicand.max_limbs(), m + n);
+
+	/* subquadratic kernels compute the full product and truncate */
+	if (std::min(m, n) >= karatsuba_threshold) {
+		const bignum &a = m >= n ? multiplicand : multiplier;
+		const bignum &b = m >= n ? multiplier : multiplicand;
+		size_t itch = _mul_itch(a.num_limbs(), b.num_limbs());
+		if (k == m + n) {
+			limb_buffer t(itch);
+			result._resize(k);
+			_mul(result.limbs.data(), a.limbs.data(), a.num_limbs(),
+				b.limbs.data(), b.num_limbs(), t.data());
+		} else {
+			limb_buffer t(m + n + itch);
+			_mul(t.data(), a.limbs.data(), a.num_limbs(),
+				b.limbs.data(), b.num_limbs(), t.data() + m + n);
+			result.limbs.assign(t.begin(), t.begin() + k);
+		}
+		result._contract();
+		return;
+	}
+
+	/* schoolbook multiply truncating each row to k limbs */
+	result._resize(k);
+	ulimb_t *r = result.limbs.data();
+	const ulimb_t *a = multiplicand.limbs.data(), *b = multiplier.limbs.data();
+	ulimb_t carry = _mul_1(r, a, std::min(m, k), b[0]);
+	if (m < k) {
+		r[m] = carry;
+	}
+	for (size_t j = 1; j < n && j < k; j++) {
+		carry = _addmul_1(r + j, a, std::min(m, k - j), b[j]);
+		if (j + m < k) {
+			r[j + m] = carry;
+		}
+	}
+	result._contract();
+}
+
+/*! base 2^limb_bits square */
+void bignum::sqr(const bignum &operand, bignum &result)
+{
+	if (&result == &operand) {
+		bignum tmp(0, result.s, result.bits);
+		sqr(operand, tmp);
+		result = std::move(tmp);
+		return;
+	}
+
+	/* fixed width results compute the full square and truncate */
+	size_t n = operand.num_limbs();
+	size_t k = std::min(operand.max_limbs(), 2 * n);
+	size_t itch = _sqr_n_itch(n);
+	if (k == 2 * n) {
+		limb_buffer t(itch);
+		result._resize(k);
+		_sqr_n(result.limbs.data(), operand.limbs.data(), n, t.data());
+	} else {
+		limb_buffer t(2 * n + itch);
+		_sqr_n(t.data(), operand.limbs.data(), n, t.data() + 2 * n);
+		result.limbs.assign(t.begin(), t.begin() + k);
+	}
+	result._contract();
+}
+
+/*! base 2^limb_bits division */
+void bignum::divrem(const bignum &dividend, const bignum &divisor, bignum &quotient, bignum &remainder)
+{
+	/* This routine is derived from Hacker's Delight,
+	 * and possibly originates from Knuth */
+
+	/* the dividend is read before the outputs are written and the
+	 * outputs only shrink when they are the dividend, so its limbs
+	 * stay in place */
+
+	ptrdiff_t m = dividend.num_limbs(), n = divisor.num_limbs();
+	const ulimb_t *v = divisor.limbs.data();
+
+	if (m < n || n <= 0 || v[n-1] == 0) {
+		remainder = dividend;
+		quotient = 0;
+		return;
+	}
+
+	// Single digit divisor
+	if (n == 1) {
+		ulimb_t d = v[0];
+		quotient._resize(m);
+		ulimb_t r = mpn<ulimb_t>::divrem_1(quotient.limbs.data(), dividend.limbs.data(), m, d);
+		quotient._contract();
+		remainder = r;
+		return;
+	}
+
+	// Normalize by shifting v left just enough so that
+	// its high-order bit is on.
+
+	int s = clz(v[n-1]); // 0 <= s < limb_bits.
+	limb_buffer vn(n);
+	if (s) {
+		_mpn().lshift(vn.data(), v, n, s);
+	} else {
+		std::copy(v, v + n, vn.begin());
+	}
+	quotient._resize(m - n + 1);
+	remainder._resize(n);
+	_divrem_norm(quotient.limbs.data(), remainder.limbs.data(), dividend.limbs.data(), m,
+		vn.data(), n, s, mpn<ulimb_t>::invert_limb(vn[n-1]));
+
+	quotient._contract();
+	remainder._contract();
+}
+
+/*! division by a nonzero 64-bit integer, returns the remainder, quotient may be the dividend */
+uint64_t bignum::divrem_1(const bignum &dividend, uint64_t divisor, bignum &quotient)
+{
+	/* a zero divisor leaves the dividend as the remainder, which need not fit */
+	assert(divisor != 0);
+	size_t m = dividend.num_limbs();
+	ulimb_t v[2];
+	if (m == 0) {
+		quotient = 0;
+		return 0;
+	}
+	if (_scalar_limbs(divisor, v) > 1) {
+		bignum remainder;
+		divrem(dividend, bignum{v[0], v[1]}, quotient, remainder);
+		return _scalar_value(remainder);
+	}
+	/* quotient may be dividend as the limbs are consumed top down */
+	quotient._resize(m);
+	ulimb_t r = mpn<ulimb_t>::divrem_1(quotient.limbs.data(),
+		dividend.limbs.data(), m, v[0]);
+	quotient._contract();
+	return r;
+}
+
+/*! multiply */
+bignum bignum::operator*(const bignum &operand) const
+{
+	bignum result(0, s, bits);
+	mult(*this, operand, result);
+	result._contract();
+	return result;
+}
+
+/*! division quotient */
+bignum bignum::operator/(const bignum &divisor) const &
+{
+	bignum quotient(0, s, bits), remainder(0, s, bits);
+	divrem(*this, divisor, quotient, remainder);
+	return quotient;
+}
+
+/* the rvalue overloads develop the quotient in the dividend */
+
+bignum bignum::operator/(const bignum &divisor) &&
+{
+	bignum remainder(0, s, bits);
+	divrem(*this, divisor, *this, remainder);
+	return std::move(*this);
+}
+
+/*! division remainder */
+bignum bignum::operator%(const bignum &divisor) const &
+{
+	bignum quotient(0), remainder(0);
+	divrem(*this, divisor, quotient, remainder);
+	return remainder;
+}
+
+bignum bignum::operator%(const bignum &divisor) &&
+{
+	if (num_limbs() < divisor.num_limbs()) {
+		return std::move(*this);
+	}
+	bignum remainder(0);
+	divrem(*this, divisor, *this, remainder);
+	return remainder;
+}
+
+/*! multiply equals */
+bignum& bignum::operator*=(const bignum &operand)
+{
+	if (&operand == this) {
+		sqr(*this, *this);
+		return *this;
+	}
+	bignum result = *this * operand;
+	*this = std::move(result);
+	return *this;
+}
+
+/*! divide equals */
+bignum& bignum::operator/=(const bignum &operand)
+{
+	bignum result = *this / operand;
+	*this = std::move(result);
+	return *this;
+}
+
+/*! modulus equals */
+bignum& bignum::operator%=(const bignum &operand)
+{
+	bignum result = *this % operand;
+	*this = std::move(result);
+	return *this;
+}
+
+
+/*---------------------------.
+| built-in integer operands. |
+`---------------------------*/
+
+/*
+ * The scalar kernels work in the result limbs with the operand split
+ * into one or two limbs, so x + 1 and x * 10 make no temporaries and
+ * in place updates touch only the limbs a carry reaches. Results copy
+ * the signedness and width of the operand like copy assignment.
+ */
+
+/*! copy operand into result with at least vn limbs up to the result width */
+static void _scalar_copy(const bignum &operand, bignum &result, size_t vn)
+{
+	if (&result != &operand) {
+		result.limbs.reserve(std::max(operand.num_limbs(), vn) + 1);
+		result = operand;
+	}
+	size_t k = std::min(result.max_limbs(), vn);
+	if (result.num_limbs() < k) result._resize(k);
+}
+
+/*! result = operand + n, result may be operand */
+void bignum::add_1(const bignum &operand, uint64_t n, bignum &result)
+{
+	ulimb_t v[2];
+	size_t vn = _scalar_limbs(n, v);
+	_scalar_copy(operand, result, vn);
+	ulimb_t *r = result.limbs.data();
+	size_t m = result.num_limbs(), j = std::min(m, vn);
+	ulimb_t carry = mpn<ulimb_t>::add_n(r, r, v, j);
+	for (size_t i = j; carry && i < m; i++) {
+		carry = ++r[i] == 0;
+	}
+	if (carry && m < result.max_limbs()) {
+		result.limbs.push_back(1);
+	}
+	result._contract();
+}
+
+/*! result = operand - n with borrow, result may be operand */
+void bignum::sub_1(const bignum &operand, uint64_t n, bignum &result)
+{
+	ulimb_t v[2];
+	size_t vn = _scalar_limbs(n, v);
+	_scalar_copy(operand, result, vn);
+	ulimb_t *r = result.limbs.data();
+	size_t m = result.num_limbs(), j = std::min(m, vn);
+	ulimb_t borrow = mpn<ulimb_t>::sub_n(r, r, v, j);
+	for (size_t i = j; borrow && i < m; i++) {
+		borrow = r[i]-- == 0;
+	}
+	/* fixed width wraps at the width rather than at the limbs present */
+	if (borrow && result.bits > 0 && m < result.max_limbs()) {
+		result.limbs.insert(result.limbs.end(), result.max_limbs() - m, ulimb_t(-1));
+	}
+	result._contract();
+}
+
+/*! result = operand * n, result may be operand */
+void bignum::mul_1(const bignum &operand, uint64_t n, bignum &result)
+{
+	ulimb_t v[2];
+	if (_scalar_limbs(n, v) > 1) {
+		mult(operand, bignum{v[0], v[1]}, result);
+		result._contract();
+		return;
+	}
+	size_t m = operand.num_limbs();
+	if (&result != &operand) {
+		result.limbs.reserve(m + 1);
+		result._resize(m);
+		result.s = operand.s;
+		if (result.bits == 0) result.bits = operand.bits;
+	}
+	ulimb_t carry = _mpn().mul_1(result.limbs.data(), operand.limbs.data(), m, v[0]);
+	if (carry && m < result.max_limbs()) {
+		result.limbs.push_back(carry);
+	}
+	result._contract();
+}
+
+/*! return dividend % divisor without a quotient, divisor != 0 */
+uint64_t bignum::mod_1(const bignum &dividend, uint64_t divisor)
+{
+	assert(divisor != 0);
+	size_t m = dividend.num_limbs();
+	ulimb_t v[2];
+	if (m == 0) return 0;
+	if (_scalar_limbs(divisor, v) > 1) {
+		bignum quotient, remainder;
+		divrem(dividend, bignum{v[0], v[1]}, quotient, remainder);
+		return _scalar_value(remainder);
+	}
+	return mpn<ulimb_t>::mod_1(dividend.limbs.data(), m, v[0]);
+}
+
+/*! compare the limbs with n, returns -1, 0 or 1 */
+int bignum::compare_ui(uint64_t n) const
+{
+	ulimb_t v[2];
+	size_t vn = _scalar_limbs(n, v), m = num_limbs();
+	while (m > vn && limbs[m - 1] == 0) m--;
+	if (m != vn) return m < vn ? -1 : 1;
+	for (size_t i = m; i-- > 0; ) {
+		if (limbs[i] != v[i]) return limbs[i] < v[i] ? -1 : 1;
+	}
+	return 0;
+}
+
+
+/*------------------.
+| fused operations. |
+`------------------*/
+
+/*
+ * The fused operations below work on variable width operands without
+ * building the product as a bignum. Fixed width operands, and outputs
+ * that alias an input the kernel still has to read, use the equivalent
+ * expression instead.
+ */
+
+/*! r[0..rn) += a[0..m) * b[0..n), m >= n, returns carry */
+static ulimb_t _addmul(ulimb_t *r, size_t rn, const ulimb_t *a, size_t m, const ulimb_t *b, size_t n)
+{
+	if (n >= bignum::karatsuba_threshold) {
+		limb_buffer t(m + n + _mul_itch(m, n));
+		_mul(t.data(), a, m, b, n, t.data() + m + n);
+		return _add(r, r, rn, t.data(), m + n);
+	}
+	ulimb_t c = 0;
+	for (size_t j = 0; j < n; j++) {
+		c = _addmul_1(r + j, a, m, b[j]);
+		for (ulimb_t *p = r + j + m; c && p < r + rn; p++) {
+			*p += c;
+			c = *p < c;
+		}
+	}
+	return c;
+}
+
+/*! r[0..rn) -= a[0..m) * b[0..n), m >= n, rn >= m + n, returns borrow */
+static ulimb_t _submul(ulimb_t *r, size_t rn, const ulimb_t *a, size_t m, const ulimb_t *b, size_t n)
+{
+	if (n >= bignum::karatsuba_threshold) {
+		limb_buffer t(m + n + _mul_itch(m, n));
+		_mul(t.data(), a, m, b, n, t.data() + m + n);
+		return _sub(r, r, rn, t.data(), m + n);
+	}
+	ulimb_t c = 0;
+	for (size_t j = 0; j < n; j++) {
+		c = _mpn().submul_1(r + j, a, m, b[j]);
+		for (ulimb_t *p = r + j + m; c && p < r + rn; p++) {
+			ulimb_t v = *p;
+			*p = v - c;
+			c = v < c;
+		}
+	}
+	return c;
+}
+
+/*! result += multiplicand * multiplier without a product temporary */
+void bignum::addmul(const bignum &multiplicand, const bignum &multiplier, bignum &result)
+{
+	if (multiplicand.bits || multiplier.bits || result.bits ||
+		&result == &multiplicand || &result == &multiplier) {
+		result += multiplicand * multiplier;
+		return;
+	}
+	const bignum &a = multiplicand.num_limbs() >= multiplier.num_limbs() ? multiplicand : multiplier;
+	const bignum &b = multiplicand.num_limbs() >= multiplier.num_limbs() ? multiplier : multiplicand;
+	size_t m = a.num_limbs(), n = b.num_limbs();
+	size_t rn = std::max(result.num_limbs(), m + n) + 1;
+	result._resize(rn);
+	_addmul(result.limbs.data(), rn, a.limbs.data(), m, b.limbs.data(), n);
+	result._contract();
+}
+
+/*! result -= multiplicand * multiplier without a product temporary */
+void bignum::submul(const bignum &multiplicand, const bignum &multiplier, bignum &result)
+{
+	/* the difference wraps at the wider of result and the product as
+	 * with operator-=, so results shorter than m + n limbs fall back */
+	size_t m = multiplicand.num_limbs(), n = multiplier.num_limbs(), rn = result.num_limbs();
+	if (multiplicand.bits || multiplier.bits || result.bits || rn < m + n ||
+		&result == &multiplicand || &result == &multiplier) {
+		result -= multiplicand * multiplier;
+		return;
+	}
+	const bignum &a = m >= n ? multiplicand : multiplier;
+	const bignum &b = m >= n ? multiplier : multiplicand;
+	_submul(result.limbs.data(), rn, a.limbs.data(), a.num_limbs(), b.limbs.data(), b.num_limbs());
+	result._contract();
+}
+
+/*! result = multiplicand * multiplier % divisor */
+void bignum::mulmod(const bignum &multiplicand, const bignum &multiplier, const bignum &divisor, bignum &result)
+{
+	size_t n = divisor.num_limbs();
+	const ulimb_t *v = divisor.limbs.data();
+	if (multiplicand.bits || multiplier.bits || divisor.bits || result.bits || v[n - 1] == 0) {
+		result = multiplicand * multiplier % divisor;
+		return;
+	}
+
+	/* one buffer holds the product, quotient, normalized divisor and the
+	 * multiplication scratch, which the division reuses once the product
+	 * is formed, and the remainder is developed in result */
+	const ulimb_t *a = multiplicand.limbs.data(), *b = multiplier.limbs.data();
+	size_t m = multiplicand.num_limbs(), k = multiplier.num_limbs();
+	while (m > 1 && a[m - 1] == 0) m--;
+	while (k > 1 && b[k - 1] == 0) k--;
+	if (m < k) {
+		std::swap(a, b);
+		std::swap(m, k);
+	}
+
+	/* a nonzero product of m and k significant limbs has m + k - 1 or
+	 * m + k, and a zero product never reaches the division */
+	size_t pn = m + k;
+	bool square = &multiplicand == &multiplier;
+	size_t itch = square ? _sqr_n_itch(m) : _mul_itch(m, k);
+	itch = std::max(itch, std::max(_divrem_norm_itch(pn, n), _divrem_norm_itch(pn - 1, n)));
+	limb_buffer t(2 * pn + n + itch);
+	ulimb_t *p = t.data(), *q = p + pn, *vn = q + pn;
+	if (square) {
+		_sqr_n(p, a, m, vn + n);
+	} else {
+		_mul(p, a, m, b, k, vn + n);
+	}
+	while (pn > 1 && p[pn - 1] == 0) pn--;
+
+	if (pn < n) {
+		result.limbs.assign(p, p + pn);
+		result._contract();
+	} else if (n == 1) {
+		result = mpn<ulimb_t>::divrem_1(q, p, pn, v[0]);
+	} else {
+		int s = clz(v[n - 1]);
+		if (s) {
+			_mpn().lshift(vn, v, n, s);
+		} else {
+			std::copy(v, v + n, vn);
+		}
+		result._resize(n);
+		_divrem_norm(q, result.limbs.data(), p, pn, vn, n, s, mpn<ulimb_t>::invert_limb(vn[n - 1]), vn + n);
+		result._contract();
+	}
+}
+
+/*! result = (operand << shamt) | other in one pass */
+void bignum::shl_or(const bignum &operand, size_t shamt, const bignum &other, bignum &result)
+{
+	if (operand.bits || other.bits || result.bits || &result == &operand || &result == &other) {
+		result = (operand << shamt) | other;
+		return;
+	}
+	size_t ls = shamt >> limb_shift, an = operand.num_limbs(), bn = other.num_limbs();
+	size_t n = std::max(an + ls + 1, bn);
+	unsigned bs = unsigned(shamt & (limb_bits - 1));
+	result._resize(n);
+	ulimb_t *r = result.limbs.data();
+	const ulimb_t *a = operand.limbs.data(), *b = other.limbs.data();
+	std::fill(r, r + ls, 0);
+	if (bs) {
+		r[ls + an] = _mpn().lshift(r + ls, a, an, bs);
+	} else {
+		std::copy(a, a + an, r + ls);
+		r[ls + an] = 0;
+	}
+	std::fill(r + ls + an + 1, r + n, 0);
+	for (size_t i = 0; i < bn; i++) {
+		r[i] |= b[i];
+	}
+	result.s = operand.s;
+	result._contract();
+}
+
+
+/*------------------.
+| divisor contexts. |
+`------------------*/
+
+/*! construct from divisor */
+bignum_divisor::bignum_divisor(const bignum &divisor)
+	: d(divisor), shift(0), dinv(0), tz(0), binv(0)
+{
+	size_t n = d.num_limbs();
+	const ulimb_t *v = d.limbs.data();
+	while (n > 0 && v[n - 1] == 0) n--;
+	if (n == 0) return;
+
+	/* normalized divisor and reciprocal for quotient estimates */
+	shift = clz(v[n - 1]);
+	vn.resize(n);
+	if (shift) {
+		_mpn().lshift(vn.data(), v, n, shift);
+	} else {
+		std::copy(v, v + n, vn.begin());
+	}
+	dinv = mpn<ulimb_t>::invert_limb(vn[n - 1]);
+
+	/* odd part and its inverse modulo 2^limb_bits for exact division */
+	size_t k = 0;
+	while (v[k] == 0) k++;
+	unsigned bit = ctz(v[k]);
+	tz = (k << bignum::limb_shift) + bit;
+	vo.resize(n - k);
+	if (bit) {
+		_mpn().rshift(vo.data(), v + k, n - k, bit);
+	} else {
+		std::copy(v + k, v + n, vo.begin());
+	}
+	if (vo.back() == 0) vo.pop_back();
+	binv = mpn<ulimb_t>::binvert_limb(vo[0]);
+}
+
+/*! quotient and remainder */
+void bignum_divisor::divrem(const bignum &dividend, bignum &quotient, bignum &remainder) const
+{
+	/* as in bignum::divrem the outputs only shrink when they are the
+	 * dividend, so its limbs stay in place until they are read */
+	size_t m = dividend.num_limbs(), n = vn.size();
+	if (m < n || n == 0) {
+		remainder = dividend;
+		quotient = 0;
+		return;
+	}
+
+	quotient._resize(m - n + 1);
+	remainder._resize(n);
+	ulimb_t *q = quotient.limbs.data(), *r = remainder.limbs.data();
+	const ulimb_t *u = dividend.limbs.data();
+	if (n == 1) {
+		r[0] = mpn<ulimb_t>::divrem_1_preinv(q, u, m, vn[0], shift, dinv);
+	} else {
+		_divrem_norm(q, r, u, m, vn.data(), n, shift, dinv);
+	}
+	quotient._contract();
+	remainder._contract();
+}
+
+/*! remainder */
+bignum bignum_divisor::mod(const bignum &dividend) const
+{
+	bignum quotient(0), remainder(0);
+	divrem(dividend, quotient, remainder);
+	return remainder;
+}
+
+/*! quotient of a dividend known to be a multiple of the divisor */
+bignum bignum_divisor::divexact(const bignum &dividend) const
+{
+	/*
+	 * Hensel division works from the low end: each quotient limb is the
+	 * low limb of the partial remainder times the inverse of the odd
+	 * divisor modulo 2^limb_bits, so no quotient estimate is corrected.
+	 */
+	size_t n = vo.size(), k = tz >> bignum::limb_shift;
+	unsigned bit = tz & (bignum::limb_bits - 1);
+	if (n == 0 || dividend.num_limbs() <= k) return bignum(0);
+
+	size_t m = dividend.num_limbs() - k;
+	const ulimb_t *u = dividend.limbs.data() + k;
+	if (n >= bignum::div_dc_threshold && m - n >= bignum::div_dc_threshold) {
+		bignum quotient(0), remainder(0);
+		divrem(dividend, quotient, remainder);
+		return quotient;
+	}
+
+	limb_buffer w(m);
+	if (bit) {
+		_mpn().rshift(w.data(), u, m, bit);
+	} else {
+		std::copy(u, u + m, w.begin());
+	}
+	while (m > 0 && w[m - 1] == 0) m--;
+	if (m < n) return bignum(0);
+
+	size_t qn = m - n + 1;
+	bignum quotient(0);
+	quotient._resize(qn);
+	ulimb_t *q = quotient.limbs.data();
+	if (n == 1) {
+		_divexact_1(q, w.data(), m, vo[0]);
+	} else {
+		for (size_t i = 0; i < qn; i++) {
+			ulimb_t qi = w[i] * binv;
+			size_t l = std::min(n, m - i);
+			ulimb_t borrow = _mpn().submul_1(&w[i], vo.data(), l, qi);
+			for (size_t j = i + l; borrow && j < m; j++) {
+				ulimb_t s = w[j];
+				w[j] = s - borrow;
+				borrow = s < borrow;
+			}
+			q[i] = qi;
+		}
+	}
+	quotient._contract();
+	return quotient;
+}
+
+/*! construct from divisor */
+bignum_barrett::bignum_barrett(const bignum &divisor) : d(divisor), mu(0)
+{
+	size_t n = d.vn.size();
+	if (n == 0) return;
+	bignum remainder(0);
+	d.divrem(bignum(1) << (2 * n * bignum::limb_bits), mu, remainder);
+}
+
+/*! quotient and remainder */
+void bignum_barrett::divrem(const bignum &dividend, bignum &quotient, bignum &remainder) const
+{
+	size_t m = dividend.num_limbs(), n = d.vn.size();
+	if (n < 2 || n >= bignum::karatsuba_threshold || m < n || m > 2 * n) {
+		d.divrem(dividend, quotient, remainder);
+		return;
+	}
+
+	/*
+	 * q3 = ((u >> (n - 1) limbs) * mu) >> (n + 1) limbs underestimates
+	 * the quotient by at most two. Only the partial products at or above
+	 * limb n - 1 are summed: the dropped ones are below n * 2^(n*limb_bits)
+	 * so q3 may be one less again. Below the karatsuba threshold these half
+	 * products cost one schoolbook product between them and the scratch
+	 * fits on the stack.
+	 */
+	enum { max_n = bignum::karatsuba_threshold };
+	ulimb_t q2[2 * max_n + 3], r[max_n + 1], p[max_n + 1];
+	const ulimb_t *u = dividend.limbs.data(), *v = d.d.limbs.data();
+	const ulimb_t *q1 = u + n - 1, *w = mu.limbs.data();
+	size_t l1 = m - n + 1, wn = mu.num_limbs();
+	q2[wn] = _mpn().mul_1(q2 + n - 1, w + n - 1, wn - n + 1, q1[0]);
+	for (size_t i = 1; i < l1; i++) {
+		size_t j = i < n - 1 ? n - 1 - i : 0;
+		q2[i + wn] = _mpn().addmul_1(q2 + i + j, w + j, wn - j, q1[i]);
+	}
+	ulimb_t *q3 = q2 + n + 1;
+	size_t qn = l1 + wn - (n + 1);
+
+	/* the remainder is below 4v so n + 1 limbs hold it exactly and only
+	 * the low n + 1 limbs of q3 * v are needed */
+	size_t k = n + 1;
+	p[n] = _mpn().mul_1(p, v, n, q3[0]);
+	for (size_t i = 1; i < std::min(qn, k); i++) {
+		_mpn().addmul_1(p + i, v, k - i, q3[i]);
+	}
+	std::copy(u, u + std::min(m, k), r);
+	if (m < k) r[n] = 0;
+	_mpn().sub_n(r, r, p, k);
+	while (r[n] != 0 || _cmp(r, v, n) >= 0) {
+		_sub(r, r, k, v, n);
+		mpn<ulimb_t>::add_1(q3, q3, qn, 1);
+	}
+
+	quotient = 0;
+	quotient.limbs.assign(q3, q3 + qn);
+	quotient._contract();
+	remainder = 0;
+	remainder.limbs.assign(r, r + k);
+	remainder._contract();
+}
+
+/*! remainder */
+bignum bignum_barrett::mod(const bignum &dividend) const
+{
+	bignum quotient(0), remainder(0);
+	divrem(dividend, quotient, remainder);
+	return remainder;
+}
+
+
+/*--------------------.
+| power via squaring. |
+`--------------------*/
+
+/*! raise to the power */
+bignum bignum::pow(size_t exp) const
+{
+	if (exp == 0) return 1;
+	bignum x = *this, y = 1;
+	while (exp > 1) {
+		if ((exp & 1) == 0) {
+			exp >>= 1;
+		} else {
+			y *= x;
+			exp = (exp - 1) >> 1;
+		}
+		sqr(x, x);
+	}
+	return x * y;
+}
+
+
+/*-------------------.
+| power table.       |
+`-------------------*/
+
+/*
+ * Radix 10 conversion splits numbers at 10^(18 * 2^k). The powers and
+ * their normalized divisors are kept in one table shared by all threads
+ * and grown on demand. Entries are never modified once appended and
+ * a deque does not move its elements, so references stay valid after
+ * the lock is released. The table outlives any arena, so it is always
+ * allocated from the heap.
+ */
+
+/*! return the divisor for 10^(18 * 2^k) */
+static const bignum_divisor& _tenp_chunk(size_t k)
+{
+	static std::mutex lock;
+	static std::deque<bignum_divisor> table;
+
+	std::lock_guard<std::mutex> guard(lock);
+	bignum_arena::heap_scope heap;
+	if (table.empty()) {
+		table.emplace_back(bignum(1000000000) * 1000000000);
+	}
+	while (table.size() <= k) {
+		bignum sq;
+		bignum::sqr(table.back().d, sq);
+		table.emplace_back(sq);
+	}
+	return table[k];
+}
+
+/*! return 10^k as a product of chunk table entries */
+static bignum _tenp_pow(size_t k)
+{
+	uint64_t r = 1;
+	for (size_t i = 0; i < k % 18; i++) r *= 10;
+	bignum p(1);
+	p *= r;
+	for (size_t j = 0, c = k / 18; c != 0; j++, c >>= 1) {
+		if (c & 1) p *= _tenp_chunk(j).d;
+	}
+	return p;
+}
+
+
+/*-------------------.
+| string conversion. |
+`-------------------*/
+
+/*! return the number of significant bits in the limbs of u */
+static size_t _bit_length(const bignum &u)
+{
+	size_t n = u.num_limbs();
+	while (n > 0 && u.limbs[n - 1] == 0) n--;
+	return n == 0 ? 0 : (bignum::limb_bits - clz(u.limbs[n - 1])) + (n - 1) * bignum::limb_bits;
+}
+
+/*! helper for recursive divide and conquer conversion to string */
+static inline ptrdiff_t _to_string_c(const ulimb_t *u, size_t un, char *s, ptrdiff_t offset)
+{
+	uint64_t v = un > 0 ? u[0] : 0;
+	if (bignum::limb_bits < 64 && un > 1) v |= uint64_t(u[1]) << (bignum::limb_bits & 63);
+	return mpn<ulimb_t>::put_dec(s + offset, v, 0) - s;
+}
+
+/*! workspace limbs for _to_string_r, quotients in tn and division scratch in dtn */
+static void _to_string_itch(size_t un, const std::vector<const bignum_divisor*> &sq, size_t level,
+	size_t &tn, size_t &dtn)
+{
+	/* a level divides at most the limbs of the next power up */
+	size_t n = sq[level]->vn.size();
+	tn = un - std::min(un, n) + 2;
+	dtn = un >= n && n > 1 ? _div_qr_itch(un + 1, n) : 0;
+	while (level-- > 0) {
+		size_t m = n;
+		n = sq[level]->vn.size();
+		tn += m - n + 2;
+		if (n > 1) dtn = std::max(dtn, _div_qr_itch(m + 1, n));
+	}
+}
+
+/*! divide u[0..un) by d leaving the remainder in u[0..n), returns quotient limbs */
+static size_t _to_string_divrem(ulimb_t *q, ulimb_t *u, size_t un, const bignum_divisor &d,
+	limb_buffer &dt)
+{
+	size_t n = d.vn.size(), qn = un - n + 1;
+	if (n == 1) {
+		u[0] = mpn<ulimb_t>::divrem_1_preinv(q, u, un, d.vn[0], d.shift, d.dinv);
+	} else {
+		size_t itch = _div_qr_itch(un + 1, n);
+		if (dt.size() < itch) dt.resize(itch);
+		u[un] = d.shift ? _mpn().lshift(u, u, un, d.shift) : 0;
+		_div_qr(q, u, un + 1, d.vn.data(), n, d.dinv, dt.data());
+		if (d.shift) {
+			_mpn().rshift(u, u, n, d.shift);
+		}
+	}
+	while (qn > 0 && q[qn - 1] == 0) qn--;
+	return qn;
+}
+
+/*
+ * The recursion divides limb spans in place. u[0..un] has room for the
+ * normalization limb and is left holding the remainder. Each level
+ * carves its quotient from the workspace t and passes the rest down.
+ * The division scratch dt is shared as it is only live within one
+ * level. to_string sizes both once with _to_string_itch; dt only grows
+ * if a level divides a value much shorter than the power above it.
+ *
+ * With more than one thread, levels whose halves have at least
+ * string_parallel_threshold digits hand the remainder to a new thread
+ * with its own workspace and half of the threads. The halves write
+ * disjoint ranges of s.
+ */
+
+/*! helper for recursive divide and conquer conversion to string */
+static ptrdiff_t _to_string_r(ulimb_t *u, size_t un, const std::vector<const bignum_divisor*> &sq, size_t level,
+	char *s, size_t digits, ptrdiff_t offset, ulimb_t *t, limb_buffer &dt, unsigned threads)
+{
+	while (un > 0 && u[un - 1] == 0) un--;
+	if (un == 0) return offset;
+
+	/* values shorter than the divisor are the remainder */
+	const bignum_divisor &d = *sq[level];
+	size_t n = d.vn.size();
+	if (un < n) {
+		return level > 0 ? _to_string_r(u, un, sq, level - 1, s, digits >> 1, offset, t, dt, threads)
+			: _to_string_c(u, un, s, offset);
+	}
+
+	ulimb_t *q = t;
+	size_t qn = _to_string_divrem(q, u, un, d, dt);
+	t += un - n + 2;
+
+	/* the remainder fills digits places below the quotient */
+	if (level > 0) {
+		if (qn == 0) {
+			return _to_string_r(u, n, sq, level - 1, s, digits >> 1, offset, t, dt, threads);
+		}
+		if (threads > 1 && digits >= bignum::string_parallel_threshold) {
+			unsigned split = threads >> 1;
+			auto lo = std::async(std::launch::async, [=, &sq] {
+				size_t tn, dtn;
+				_to_string_itch(n, sq, level - 1, tn, dtn);
+				limb_buffer w(tn), wdt(dtn);
+				_to_string_r(u, n, sq, level - 1, s, digits >> 1, offset, w.data(), wdt, split);
+			});
+			offset = _to_string_r(q, qn, sq, level - 1, s, digits >> 1, offset - digits, t, dt, threads - split);
+			lo.get();
+			return offset;
+		}
+		_to_string_r(u, n, sq, level - 1, s, digits >> 1, offset, t, dt, threads);
+		return _to_string_r(q, qn, sq, level - 1, s, digits >> 1, offset - digits, t, dt, threads);
+	} else {
+		if (qn == 0) {
+			return _to_string_c(u, n, s, offset);
+		}
+		_to_string_c(u, n, s, offset);
+		return _to_string_c(q, qn, s, offset - digits);
+	}
+}
+
+/*! select chunk powers for converting u, returns digits of the largest */
+static size_t _to_string_powers(const bignum &u, std::vector<const bignum_divisor*> &sq)
+{
+	/* square the chunk size until its square exceeds u */
+	size_t ub = _bit_length(u);
+	size_t digits = 18;
+	sq = { &_tenp_chunk(0) };
+	do {
+		sq.push_back(&_tenp_chunk(sq.size()));
+		digits <<= 1;
+	} while (2 * (sq.back()->d.num_bits() - 1) < ub);
+	return digits;
+}
+
+/*
+ * Streaming output walks the same tree as to_string but visits the
+ * quotient before the remainder so digits leave in order. Subtrees
+ * that fit half of the sink buffer are formatted with _to_string_r
+ * directly into it, so only the limb workspace scales with the value.
+ */
+
+/*! buffered digit output flushed through write(const char*, size_t) */
+template <typename W>
+struct _digit_sink
+{
+	enum { capacity = 8192 };
+
+	W write;
+	size_t len;
+	bool ok;
+	char buf[capacity];
+
+	_digit_sink(W write) : write(write), len(0), ok(true) {}
+
+	char* reserve(size_t n) { if (len + n > capacity) flush(); return buf + len; }
+	void commit(size_t n) { len += n; }
+	void flush() { if (len > 0 && ok) ok = write(buf, len); len = 0; }
+
+	void fill(char c, size_t n)
+	{
+		while (n > 0) {
+			if (len == capacity) flush();
+			size_t k = std::min(n, capacity - len);
+			std::memset(buf + len, c, k);
+			len += k;
+			n -= k;
+		}
+	}
+};
+
+/*! helper for streaming conversion, pad emits all 2 * digits places */
+template <typename S>
+static void _write_decimal_r(ulimb_t *u, size_t un, const std::vector<const bignum_divisor*> &sq, size_t level,
+	size_t digits, bool pad, ulimb_t *t, limb_buffer &dt, S &out)
+{
+	while (un > 0 && u[un - 1] == 0) un--;
+
+	size_t width = digits << 1;
+	if (width <= S::capacity / 2) {
+		char *p = out.reserve(width);
+		std::fill(p, p + width, '0');
+		ptrdiff_t offset = _to_string_r(u, un, sq, level, p, digits, width, t, dt, 1);
+		if (!pad) {
+			std::memmove(p, p + offset, width - offset);
+			width -= offset;
+		}
+		out.commit(width);
+		return;
+	}
+
+	/* values shorter than the divisor have a zero quotient */
+	const bignum_divisor &d = *sq[level];
+	size_t n = d.vn.size();
+	if (un < n) {
+		if (pad) out.fill('0', digits);
+		_write_decimal_r(u, un, sq, level - 1, digits >> 1, pad, t, dt, out);
+		return;
+	}
+
+	ulimb_t *q = t;
+	size_t qn = _to_string_divrem(q, u, un, d, dt);
+	t += un - n + 2;
+	if (qn > 0 || pad) {
+		_write_decimal_r(q, qn, sq, level - 1, digits >> 1, pad, t, dt, out);
+	}
+	_write_decimal_r(u, n, sq, level - 1, digits >> 1, pad || qn > 0, t, dt, out);
+}
+
+/*! stream radix 10 digits through write, returns false if a write fails */
+template <typename W>
+static bool _write_decimal(const bignum &b, W write)
+{
+	_digit_sink<W> out(write);
+	if (b == 0) {
+		out.fill('0', 1);
+	} else {
+		std::vector<const bignum_divisor*> sq;
+		size_t un = b.num_limbs(), tn, dtn;
+		size_t digits = _to_string_powers(b, sq);
+		_to_string_itch(un, sq, sq.size() - 1, tn, dtn);
+		limb_buffer work(un + 1 + tn), dt(dtn);
+		std::copy(b.limbs.begin(), b.limbs.end(), work.begin());
+		_write_decimal_r(work.data(), un, sq, sq.size() - 1, digits, false, work.data() + un + 1, dt, out);
+	}
+	out.flush();
+	return out.ok;
+}
+
+/*! stream radix 2 or 16 digits through write, returns false if a write fails */
+template <typename W>
+static bool _write_2exp(const bignum &b, unsigned shift, W write)
+{
+	static const char* hexdigits = "0123456789abcdef";
+
+	_digit_sink<W> out(write);
+	char *p = out.reserve(2);
+	p[0] = '0';
+	p[1] = shift == 4 ? 'x' : 'b';
+	out.commit(2);
+
+	/* digits from the most significant, in pieces of half the buffer */
+	const ulimb_t mask = (ulimb_t(1) << shift) - 1;
+	const size_t per_limb = bignum::limb_bits / shift;
+	size_t nd = std::max(size_t(1), (_bit_length(b) + shift - 1) / shift);
+	while (nd > 0) {
+		size_t k = std::min(nd, size_t(_digit_sink<W>::capacity / 2));
+		p = out.reserve(k);
+		for (size_t i = 0; i < k; i++) {
+			size_t d = nd - 1 - i;
+			p[i] = hexdigits[(b.limbs[d / per_limb] >> ((d % per_limb) * shift)) & mask];
+		}
+		out.commit(k);
+		nd -= k;
+	}
+	out.flush();
+	return out.ok;
+}
+
+/*! helper for recursive divide and conquer conversion from string */
+static bignum _from_string_c(const char *str, size_t len)
+{
+	/* accumulate the largest power of ten chunks that fit in a limb */
+	const size_t chunk = bignum::limb_bits == 64 ? 19 : 9;
+	ulimb_t base = 1;
+	for (size_t i = 0; i < chunk; i++) base *= 10;
+
+	/* log2(10) < 3402 / 1024 bounds the limbs required */
+	bignum val;
+	val._resize(((len * 3402) >> 10) / bignum::limb_bits + 2);
+	ulimb_t *r = val.limbs.data();
+	size_t n = 1;
+	for (size_t i = 0, k = (len - 1) % chunk + 1; i < len; i += k, k = chunk) {
+		ulimb_t v = 0;
+		size_t j = i;
+		for (; j + 8 <= i + k; j += 8) {
+			v = v * 100000000 + mpn<ulimb_t>::unpack_dec_8(mpn<ulimb_t>::load_8(str + j));
+		}
+		for (; j < i + k; j++) {
+			v = v * 10 + ulimb_t(str[j] - '0');
+		}
+		ulimb_t c = _mpn().mul_1(r, r, n, base);
+		c += mpn<ulimb_t>::add_1(r, r, n, v);
+		if (c) r[n++] = c;
+	}
+	val._resize(n);
+	val._contract();
+	return val;
+}
+
+/*! helper for recursive divide and conquer conversion from string */
+static bignum _from_string_r(const char *str, size_t len, const std::vector<const bignum_divisor*> &sq, size_t level,
+	unsigned threads)
+{
+	if (len <= bignum::from_string_dc_threshold) {
+		return _from_string_c(str, len);
+	}
+
+	/* split off the low 18 * 2^level digits, len <= 36 * 2^level */
+	while (level > 0 && len <= (size_t(18) << level)) level--;
+	size_t digits = size_t(18) << level;
+	if (threads > 1 && digits >= bignum::string_parallel_threshold) {
+		/* the low half runs on a new thread with half of the threads */
+		unsigned split = threads >> 1;
+		auto lo = std::async(std::launch::async, _from_string_r,
+			str + len - digits, digits, std::cref(sq), level - (level > 0), split);
+		bignum hi = _from_string_r(str, len - digits, sq, level - (level > 0), threads - split);
+		bignum val = hi * sq[level]->d;
+		val += lo.get();
+		return val;
+	}
+	bignum hi = _from_string_r(str, len - digits, sq, level - (level > 0), threads);
+	bignum lo = _from_string_r(str + len - digits, digits, sq, level - (level > 0), threads);
+	bignum val = hi * sq[level]->d;
+	val += lo;
+	return val;
+}
+
+static std::atomic<unsigned> _conversion_threads(1);
+
+/*! set threads used for radix 10 conversion, 0 selects all cores */
+void bignum::set_conversion_threads(unsigned n)
+{
+	if (n == 0) n = std::max(1u, std::thread::hardware_concurrency());
+	_conversion_threads = n;
+}
+
+/*! return threads used for radix 10 conversion */
+unsigned bignum::conversion_threads()
+{
+	return _conversion_threads;
+}
+
+/*! convert from bignum to string */
+std::string bignum::to_string(size_t radix) const
+{
+	static const char* hexdigits = "0123456789abcdef";
+	static const size_t dgib = 3566893131; /* log2(10) * 1024^3 */
+
+	switch (radix) {
+		case 10: {
+			if (*this == 0) return "0";
+
+			/* estimate string length */
+			std::string s;
+			size_t climit = (size_t)(((long long)(num_limbs()) << (limb_shift + 30)) / (long long)dgib) + 1;
+			s.resize(climit, '0');
+
+			/* one workspace for the value, the quotients and the division scratch */
+			std::vector<const bignum_divisor*> sq;
+			size_t un = num_limbs(), tn, dtn;
+			size_t digits = _to_string_powers(*this, sq);
+			_to_string_itch(un, sq, sq.size() - 1, tn, dtn);
+			limb_buffer work(un + 1 + tn), dt(dtn);
+			std::copy(limbs.begin(), limbs.end(), work.begin());
+
+			/* recursively divide by chunk squares */
+			ulimb_t *u = work.data(), *t = u + un + 1;
+			ptrdiff_t offset = _to_string_r(u, un, sq, sq.size() - 1, &s[0], digits, climit, t, dt,
+				conversion_threads());
+
+			/* return less reserve */
+			s.erase(0, offset);
+			return s;
+		}
+		case 2: {
 			if (*this == 0) return "0b0";
 
 			std::string s("0b");
@@ -772,11 +2743,121 @@ std::string bignum::to_string(size_t radix) const
 	}
 }
 
+/*! write decimal digits to a stream without building the string */
+void bignum::write_decimal(std::ostream &os) const
+{
+	_write_decimal(*this, [&os](const char *buf, size_t len) {
+		return bool(os.write(buf, len));
+	});
+}
+
+/*! write digits to a file without building the string */
+bool bignum::write_to(FILE *f, size_t radix) const
+{
+	auto write = [f](const char *buf, size_t len) {
+		return fwrite(buf, 1, len, f) == len;
+	};
+	switch (radix) {
+		case 10: return _write_decimal(*this, write);
+		case 2: return _write_2exp(*this, 1, write);
+		case 16: return _write_2exp(*this, 4, write);
+		default: return false;
+	}
+}
+
+/*! return the exact number of characters to_string produces */
+size_t bignum::to_chars_size(size_t radix) const
+{
+	size_t ub = _bit_length(*this);
+	switch (radix) {
+		case 10: {
+			if (ub == 0) return 1;
+
+			/*
+			 * log10 of the top limbs in double precision is far closer
+			 * to log10(u) than eps, so it gives the digit count unless u
+			 * is within eps of a power of ten. One comparison against
+			 * that power settles the rest.
+			 */
+			size_t i = (ub + limb_bits - 1) >> limb_shift, k;
+			double t = 0;
+			for (size_t j = 0; j * limb_bits < 96 && i > 0; j++) {
+				t = std::ldexp(t, limb_bits) + double(limbs[--i]);
+			}
+			double x = std::log10(t) + double(i * limb_bits) * 0.30102999566398120;
+			double eps = 1e-9 + x * 1e-12;
+			k = size_t(x + 0.5);
+			if (std::fabs(x - double(k)) > eps) return size_t(x) + 1;
+
+			bignum p = _tenp_pow(k);
+			size_t un = (ub + limb_bits - 1) >> limb_shift;
+			size_t pn = (_bit_length(p) + limb_bits - 1) >> limb_shift;
+			bool ge = un != pn ? un > pn : _cmp(limbs.data(), p.limbs.data(), un) >= 0;
+			return ge ? k + 1 : k;
+		}
+		case 2: return 2 + std::max(size_t(1), ub);
+		case 16: return 2 + std::max(size_t(1), (ub + 3) >> 2);
+		default: return 0;
+	}
+}
+
+/*! write to_string characters to [first, last), returns the end or nullptr if they do not fit */
+char* bignum::to_chars(char *first, char *last, size_t radix) const
+{
+	char *p = first;
+	auto write = [&p, last](const char *buf, size_t len) {
+		if (size_t(last - p) < len) return false;
+		std::memcpy(p, buf, len);
+		p += len;
+		return true;
+	};
+	bool ok;
+	switch (radix) {
+		case 10: ok = _write_decimal(*this, write); break;
+		case 2: ok = _write_2exp(*this, 1, write); break;
+		case 16: ok = _write_2exp(*this, 4, write); break;
+		default: ok = false;
+	}
+	return ok ? p : nullptr;
+}
+
+/*! parse a run of digits from [first, last), returns the end or nullptr if there are none */
+const char* bignum::from_chars(const char *first, const char *last, size_t radix)
+{
+	if (last - first > 2 && first[0] == '0') {
+		if (first[1] == 'b' && (radix == 0 || radix == 2)) {
+			radix = 2;
+			first += 2;
+		} else if (first[1] == 'x' && (radix == 0 || radix == 16)) {
+			radix = 16;
+			first += 2;
+		}
+	}
+	if (radix == 0) {
+		radix = 10;
+	}
+	if (radix != 2 && radix != 10 && radix != 16) return nullptr;
+	const char *end = mpn<ulimb_t>::scan_digits(first, last, radix);
+	if (end == first) return nullptr;
+
+	/* leading zeros keep from_string from reading 0b as a prefix */
+	while (end - first > 1 && *first == '0') first++;
+	*this = 0;
+	from_string(first, end - first, radix);
+	_contract();
+	return end;
+}
+
+/*! write decimal digits to a stream */
+std::ostream& operator<<(std::ostream &os, const bignum &b)
+{
+	b.write_decimal(os);
+	return os;
+}
+
 /*! convert to bignum from string */
 void bignum::from_string(const char *str, size_t len, size_t radix)
 {
-	static const bignum tenp18{0xa7640000, 0xde0b6b3};
-	static const bignum twop64{0,0,1};
 	if (len > 2) {
 		if (strncmp(str, "0b", 2) == 0) {
 			radix = 2;
@@ -793,44 +2874,49 @@ void bignum::from_string(const char *str, size_t len, size_t radix)
 	}
 	switch (radix) {
 		case 10: {
-			for (size_t i = 0; i < len; i += 18) {
-				size_t chunklen = i + 18 < len ? 18 : len - i;
-				std::string chunk(str + i, chunklen);
-				udlimb_t num = strtoull(chunk.c_str(), nullptr, 10);
-				if (chunklen == 18) {
-					*this *= tenp18;
-				} else {
-					*this *= bignum(10).pow(chunklen);
-				}
-				*this += bignum{ulimb_t(num), ulimb_t(num >> limb_bits)};
+			if (len == 0) break;
+
+			/* square the chunk size until ~= len / 2 */
+			size_t digits = 18;
+			std::vector<const bignum_divisor*> sq = { &_tenp_chunk(0) };
+			while ((digits << 1) < len) {
+				sq.push_back(&_tenp_chunk(sq.size()));
+				digits <<= 1;
 			}
-			break;
-		}
-		case 2: {
-			for (size_t i = 0; i < len; i += 64) {
-				size_t chunklen = i + 64 < len ? 64 : len - i;
-				std::string chunk(str + i, chunklen);
-				udlimb_t num = strtoull(chunk.c_str(), nullptr, 2);
-				if (chunklen == 64) {
-					*this *= twop64;
+
+			/* recursively multiply by chunk squares */
+			bignum val = _from_string_r(str, len, sq, sq.size() - 1, conversion_threads());
+			if (*this != 0) {
+				if (len < 20) {
+					uint64_t p = 1;
+					for (size_t i = 0; i < len; i++) p *= 10;
+					*this *= p;
 				} else {
-					*this *= bignum(2).pow(chunklen);
+					*this *= _tenp_pow(len);
 				}
-				*this += bignum{ulimb_t(num), ulimb_t(num >> limb_bits)};
+				*this += val;
+			} else {
+				limbs = std::move(val.limbs);
+				_contract();
 			}
 			break;
 		}
+		case 2:
 		case 16: {
-			for (size_t i = 0; i < len; i += 16) {
-				size_t chunklen = i + 16 < len ? 16 : len - i;
-				std::string chunk(str + i, chunklen);
-				udlimb_t num = strtoull(chunk.c_str(), nullptr, 16);
-				if (chunklen == 16) {
-					*this *= twop64;
-				} else {
-					*this *= bignum(16).pow(chunklen);
-				}
-				*this += bignum{ulimb_t(num), ulimb_t(num >> limb_bits)};
+			if (len == 0) break;
+
+			/* pack the digits directly into limbs */
+			unsigned shift = radix == 16 ? 4 : 1;
+			bignum val;
+			val._resize((len * shift + limb_bits - 1) >> limb_shift);
+			mpn<ulimb_t>::set_str_2exp(val.limbs.data(), val.num_limbs(), str, len, shift);
+			val._contract();
+			if (*this != 0) {
+				*this <<= len * shift;
+				*this += val;
+			} else {
+				limbs = std::move(val.limbs);
+				_contract();
 			}
 			break;
 		}
@@ -839,3 +2925,194 @@ void bignum::from_string(const char *str, size_t len, size_t radix)
 		}
 	}
 }
+
+
+/*-------------------.
+| limb memory.       |
+`-------------------*/
+
+static void* _default_alloc(size_t size) { return ::operator new(size); }
+static void _default_free(void *p, size_t) { ::operator delete(p); }
+
+/*
+ * The memory functions are published as one immutable pair so that an
+ * allocation never sees the alloc function of one call to
+ * set_memory_functions with the free function of another. Pairs are
+ * kept for the life of the process and reused when set again.
+ */
+struct _memory_funcs
+{
+	bignum::alloc_func alloc;
+	bignum::free_func free;
+};
+
+static const _memory_funcs _default_memory = { _default_alloc, _default_free };
+static std::atomic<const _memory_funcs*> _memory(&_default_memory);
+
+/*
+ * Each block starts with a header holding the arena that owns it, or
+ * null and the free function current when it came from the heap. The
+ * header is a multiple of the arena alignment so blocks stay aligned.
+ */
+struct _block_header
+{
+	bignum_arena *arena;
+	bignum::free_func free;
+};
+
+static const size_t _block_size = (sizeof(_block_header) + bignum_arena::align - 1)
+	& ~size_t(bignum_arena::align - 1);
+
+static inline _block_header* _block_of(void *p)
+{
+	return reinterpret_cast<_block_header*>(static_cast<char*>(p) - _block_size);
+}
+
+/* the arena that new blocks come from on this thread, null in a heap_scope */
+static thread_local bignum_arena *_arena_active = nullptr;
+
+void* bignum_alloc(size_t size)
+{
+	if (_arena_active) return _arena_active->allocate(size);
+	const _memory_funcs *m = _memory.load(std::memory_order_acquire);
+	_block_header *h = static_cast<_block_header*>(m->alloc(size + _block_size));
+	h->arena = nullptr;
+	h->free = m->free;
+	return reinterpret_cast<char*>(h) + _block_size;
+}
+
+void bignum_free(void *p, size_t size)
+{
+	_block_header *h = _block_of(p);
+	if (h->arena) {
+		h->arena->deallocate(p, size);
+	} else {
+		h->free(h, size + _block_size);
+	}
+}
+
+/*! set limb memory functions for new blocks, nullptr restores operator new and delete */
+void bignum::set_memory_functions(alloc_func alloc, free_func free)
+{
+	static std::mutex lock;
+	static std::deque<_memory_funcs> pairs;
+
+	_memory_funcs f = { alloc ? alloc : _default_alloc, free ? free : _default_free };
+	std::lock_guard<std::mutex> guard(lock);
+	const _memory_funcs *m = &_default_memory;
+	if (f.alloc != m->alloc || f.free != m->free) {
+		auto i = std::find_if(pairs.begin(), pairs.end(), [&f](const _memory_funcs &e) {
+			return e.alloc == f.alloc && e.free == f.free;
+		});
+		if (i == pairs.end()) i = pairs.insert(pairs.end(), f);
+		m = &*i;
+	}
+	_memory.store(m, std::memory_order_release);
+}
+
+/*! return the limb memory functions */
+void bignum::get_memory_functions(alloc_func *alloc, free_func *free)
+{
+	const _memory_funcs *m = _memory.load(std::memory_order_acquire);
+	if (alloc) *alloc = m->alloc;
+	if (free) *free = m->free;
+}
+
+
+/*-------------------.
+| bignum_arena.      |
+`-------------------*/
+
+static size_t _arena_round(size_t size)
+{
+	return (size + bignum_arena::align - 1) & ~size_t(bignum_arena::align - 1);
+}
+
+bignum_arena::heap_scope::heap_scope() : saved(_arena_active)
+{
+	_arena_active = nullptr;
+}
+
+bignum_arena::heap_scope::~heap_scope()
+{
+	_arena_active = saved;
+}
+
+/*! construct an arena growing by chunks of at least chunk_size bytes */
+bignum_arena::bignum_arena(size_t chunk_size)
+	: bignum_arena(nullptr, 0, chunk_size) {}
+
+/*! construct an arena that allocates from buf before adding chunks */
+bignum_arena::bignum_arena(void *buf, size_t size, size_t chunk_size)
+	: first{nullptr, static_cast<char*>(buf), size, nullptr}, chunks(&first),
+	  cur(first.base), end(first.base + size), next_size(chunk_size),
+	  saved(_arena_active)
+{
+	/* align the caller buffer */
+	if (buf) {
+		size_t skew = _arena_round(uintptr_t(buf)) - uintptr_t(buf);
+		cur += std::min(skew, size);
+	}
+	_arena_active = this;
+}
+
+/*! release all chunks and restore the enclosing arena */
+bignum_arena::~bignum_arena()
+{
+	for (chunk *c = chunks; c != &first; ) {
+		chunk *next = c->next;
+		c->free(c, c->size + _arena_round(sizeof(chunk)));
+		c = next;
+	}
+	_arena_active = saved;
+}
+
+/*! allocate size bytes aligned to align */
+void* bignum_arena::allocate(size_t size)
+{
+	size = _arena_round(size) + _block_size;
+	if (size_t(end - cur) < size) {
+		const _memory_funcs *m = _memory.load(std::memory_order_acquire);
+		size_t n = std::max(next_size, size), h = _arena_round(sizeof(chunk));
+		chunk *c = static_cast<chunk*>(m->alloc(n + h));
+		c->next = chunks;
+		c->base = reinterpret_cast<char*>(c) + h;
+		c->size = n;
+		c->free = m->free;
+		chunks = c;
+		cur = c->base;
+		end = c->base + n;
+		next_size *= 2;
+	}
+	_block_header *b = reinterpret_cast<_block_header*>(cur);
+	b->arena = this;
+	b->free = nullptr;
+	cur += size;
+	return cur - size + _block_size;
+}
+
+/*! rewind if p is the most recent allocation */
+void bignum_arena::deallocate(void *p, size_t size)
+{
+	if (static_cast<char*>(p) + _arena_round(size) == cur) {
+		cur = static_cast<char*>(p) - _block_size;
+	}
+}
+
+/*! test whether p lies in one of the chunks */
+bool bignum_arena::owns(const void *p) const
+{
+	uintptr_t q = uintptr_t(p);
+	for (const chunk *c = chunks; c; c = c->next) {
+		if (q >= uintptr_t(c->base) && q < uintptr_t(c->base) + c->size) return true;
+	}
+	return false;
+}
+
+/*! return the bytes held in chunks other than the caller buffer */
+size_t bignum_arena::chunk_bytes() const
+{
+	size_t n = 0;
+	for (const chunk *c = chunks; c != &first; c = c->next) n += c->size;
+	return n;
+}
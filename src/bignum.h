@@ -2,6 +2,7 @@
 
 #pragma once
 
+#include <cstdio>
 #include <cstdlib>
 #include <cstddef>
 #include <cstring>
@@ -11,10 +12,30 @@
 #include <iostream>
 #include <algorithm>
 #include <initializer_list> 
+#include <iterator>
+#include <new>
+#include <type_traits>
 
 #include "bits.h"
 #include "hostint.h"
 
+/*
+ * BIGNUM_LIMB_BITS selects the limb width at compile time. 32-bit limbs
+ * use uint64_t for double-limb arithmetic; 64-bit limbs require a
+ * compiler with unsigned __int128.
+ */
+#ifndef BIGNUM_LIMB_BITS
+#define BIGNUM_LIMB_BITS 32
+#endif
+
+#if BIGNUM_LIMB_BITS != 32 && BIGNUM_LIMB_BITS != 64
+#error "BIGNUM_LIMB_BITS must be 32 or 64"
+#endif
+
+#if BIGNUM_LIMB_BITS == 64 && !defined(__SIZEOF_INT128__)
+#error "BIGNUM_LIMB_BITS=64 requires unsigned __int128"
+#endif
+
 /*------------------.
 | signedness.       |
 `------------------*/
@@ -47,10 +68,167 @@ struct bitwidth
 	operator unsigned () const { return width; }
 };
 
+/*------------------.
+| limb memory.      |
+`------------------*/
+
+/*!
+ * Limb storage is allocated from the innermost bignum_arena active on
+ * the calling thread, or else through the process-wide memory functions
+ * set with bignum::set_memory_functions. Each block starts with a header
+ * naming the arena that owns it or the free function it was allocated
+ * with, so blocks are freed with their size to where they came from,
+ * without searching the arenas, even after the memory functions change.
+ */
+void* bignum_alloc(size_t size);
+void bignum_free(void *p, size_t size);
+
+/*! standard allocator for limb scratch vectors using bignum_alloc */
+template <typename T>
+struct limb_allocator
+{
+	typedef T value_type;
+
+	limb_allocator() = default;
+	template <typename U> limb_allocator(const limb_allocator<U> &) {}
+
+	T* allocate(size_t n) { return static_cast<T*>(bignum_alloc(n * sizeof(T))); }
+	void deallocate(T *p, size_t n) { bignum_free(p, n * sizeof(T)); }
+
+	template <typename U> bool operator==(const limb_allocator<U> &) const { return true; }
+	template <typename U> bool operator!=(const limb_allocator<U> &) const { return false; }
+};
+
+/*------------------.
+| limb_vector.      |
+`------------------*/
+
+/*!
+ * limb_vector is a vector of limbs that keeps up to N elements inline
+ * and spills to the heap only when it grows beyond them. It provides
+ * the subset of std::vector that bignum uses, zero-fills on growth and
+ * moves by stealing heap storage or copying the inline elements.
+ */
+template <typename T, size_t N>
+struct limb_vector
+{
+	T *p;
+	size_t n, cap;
+	T buf[N];
+
+	limb_vector() : p(buf), n(0), cap(N) {}
+	limb_vector(std::initializer_list<T> l) : limb_vector() { assign(l.begin(), l.end()); }
+	limb_vector(const limb_vector &o) : limb_vector() { assign(o.begin(), o.end()); }
+	limb_vector(limb_vector &&o) : limb_vector() { _take(o); }
+	~limb_vector() { if (p != buf) _free(p, cap); }
+
+	limb_vector& operator=(const limb_vector &o)
+	{
+		if (this != &o) assign(o.begin(), o.end());
+		return *this;
+	}
+
+	limb_vector& operator=(limb_vector &&o)
+	{
+		if (this != &o) {
+			if (p != buf) _free(p, cap);
+			p = buf, n = 0, cap = N;
+			_take(o);
+		}
+		return *this;
+	}
+
+	size_t size() const { return n; }
+	size_t capacity() const { return cap; }
+	bool empty() const { return n == 0; }
+	bool is_inline() const { return p == buf; }
+
+	T* data() { return p; }
+	const T* data() const { return p; }
+	T* begin() { return p; }
+	const T* begin() const { return p; }
+	T* end() { return p + n; }
+	const T* end() const { return p + n; }
+	T& operator[](size_t i) { return p[i]; }
+	const T& operator[](size_t i) const { return p[i]; }
+	T& back() { return p[n - 1]; }
+	const T& back() const { return p[n - 1]; }
+
+	void reserve(size_t c) { if (c > cap) _grow(c); }
+	void clear() { n = 0; }
+	void pop_back() { n--; }
+
+	void push_back(T v)
+	{
+		if (n == cap) _grow(cap * 2);
+		p[n++] = v;
+	}
+
+	void resize(size_t m)
+	{
+		if (m > cap) _grow(std::max(m, cap * 2));
+		if (m > n) std::fill(p + n, p + m, T(0));
+		n = m;
+	}
+
+	template <typename I> void assign(I first, I last)
+	{
+		size_t m = size_t(std::distance(first, last));
+		if (m > cap) {
+			n = 0;
+			_grow(m);
+		}
+		std::copy(first, last, p);
+		n = m;
+	}
+
+	void insert(T *pos, size_t count, T v)
+	{
+		size_t i = size_t(pos - p), m = n;
+		resize(n + count);
+		std::copy_backward(p + i, p + m, p + m + count);
+		std::fill(p + i, p + i + count, v);
+	}
+
+	void erase(T *first, T *last)
+	{
+		std::copy(last, p + n, first);
+		n -= size_t(last - first);
+	}
+
+	/*! move storage from o, leaving o empty and inline */
+	void _take(limb_vector &o)
+	{
+		if (o.p != o.buf) {
+			p = o.p, n = o.n, cap = o.cap;
+			o.p = o.buf, o.cap = N;
+		} else {
+			std::copy(o.buf, o.buf + o.n, buf);
+			n = o.n;
+		}
+		o.n = 0;
+	}
+
+	/*! reallocate to capacity c keeping the first n elements */
+	void _grow(size_t c)
+	{
+		T *q = _alloc(c);
+		std::copy(p, p + n, q);
+		if (p != buf) _free(p, cap);
+		p = q, cap = c;
+	}
+
+	static T* _alloc(size_t c) { return static_cast<T*>(bignum_alloc(c * sizeof(T))); }
+	static void _free(T *q, size_t c) { bignum_free(q, c * sizeof(T)); }
+};
+
 /*------------------.
 | bignum.           |
 `------------------*/
 
+struct bignum_leaf;
+template <typename Op, typename L, typename R> struct bignum_expr;
+
 struct bignum
 {
 	/*------------------.
@@ -59,8 +237,32 @@ struct bignum
 
 	/*! limb bit width and bit shift */
 	enum {
-		limb_bits = 32,
-		limb_shift = 5,
+		limb_bits = BIGNUM_LIMB_BITS,
+		limb_shift = BIGNUM_LIMB_BITS == 64 ? 6 : 5,
+	};
+
+	/*! multiplication algorithm thresholds in limbs */
+	enum {
+		karatsuba_threshold = 32,
+		toom3_threshold = 128,
+		toom4_threshold = 384,
+		fft_threshold = BIGNUM_LIMB_BITS == 64 ? 3072 : 768,
+	};
+
+	/*! limbs stored inline before spilling to the heap (256 bits plus a carry) */
+	enum {
+		inline_limbs = 256 / BIGNUM_LIMB_BITS + 1,
+	};
+
+	/*! division algorithm thresholds in limbs */
+	enum {
+		div_dc_threshold = 48,
+	};
+
+	/*! radix conversion thresholds in decimal digits */
+	enum {
+		from_string_dc_threshold = 1000,
+		string_parallel_threshold = 20000,
 	};
 
 	/*! limb type */
@@ -68,12 +270,19 @@ struct bignum
 	typedef hostint<limb_bits*2, false>::type udlimb_t;
 	typedef hostint<limb_bits*2, true>::type sdlimb_t;
 
+	/*! scratch limb vector allocated through the limb memory functions */
+	typedef std::vector<ulimb_t, limb_allocator<ulimb_t>> limb_buffer;
+
+	/*! limb memory functions, free receives the size passed to alloc */
+	typedef void* (*alloc_func)(size_t size);
+	typedef void (*free_func)(void *p, size_t size);
+
 	/*------------------.
 	| member variables. |
 	`------------------*/
 
 	/* limbs is a vector of words with the little end at offset 0 */
-	std::vector<ulimb_t> limbs;
+	limb_vector<ulimb_t, inline_limbs> limbs;
 
 	/*! flags indicating unsigned or signed two's complement */
 	signedness s;
@@ -104,8 +313,12 @@ struct bignum
 	/*! copy constructor */
 	bignum(const bignum &operand);
 
-	/*! move constructor */
-	bignum(const bignum&& operand) noexcept;
+	/*! move constructor, leaves operand zero */
+	bignum(bignum &&operand) noexcept;
+
+	/*! lazy expression constructor */
+	template <typename Op, typename L, typename R>
+	bignum(const bignum_expr<Op, L, R> &e);
 
 
 	/*----------------------.
@@ -118,9 +331,13 @@ struct bignum
 	/*! bignum copy assignment operator */
 	bignum& operator=(const bignum &operand);
 
-	/*! bignum move assignment operator */
+	/*! bignum move assignment operator, leaves operand zero */
 	bignum& operator=(bignum &&operand);
 
+	/*! lazy expression assignment operator, evaluates into this storage */
+	template <typename Op, typename L, typename R>
+	bignum& operator=(const bignum_expr<Op, L, R> &e);
+
 
 	/*------------------.
 	| internal methods. |
@@ -135,6 +352,24 @@ struct bignum
 	/*! resize number of limbs */
 	void _resize(size_t n);
 
+	/*! copy with capacity for n limbs */
+	bignum _copy(size_t n) const;
+
+	/*! assign a 64-bit integer keeping signedness and width */
+	bignum& _assign_ui(uint64_t n);
+
+	/*! sign and magnitude of a built-in integer operand */
+	template <typename I> static bool _neg(I n, std::true_type) { return n < 0; }
+	template <typename I> static bool _neg(I, std::false_type) { return false; }
+	template <typename I> static bool _neg(I n) { return _neg(n, std::is_signed<I>()); }
+	template <typename I> static uint64_t _mag(I n) { return _neg(n) ? 0 - uint64_t(n) : uint64_t(n); }
+
+	/*! compare with a negative integer of magnitude mag */
+	int _compare_neg(uint64_t mag) const;
+
+	/*! negate in two's complement at the width, or at the limbs present for variable width */
+	bignum& _negate_wrap();
+
 
 	/*-------------------------------.
 	| limb and bit accessor methods. |
@@ -191,31 +426,40 @@ struct bignum
 	bignum& operator^=(const bignum &operand);
 
 	/*! add with carry */
-	bignum operator+(const bignum &operand) const;
+	bignum operator+(const bignum &operand) const &;
+	bignum operator+(const bignum &operand) &&;
 
 	/*! subtract with borrow */
-	bignum operator-(const bignum &operand) const;
+	bignum operator-(const bignum &operand) const &;
+	bignum operator-(const bignum &operand) &&;
 
 	/*! left shift */
-	bignum operator<<(size_t shamt) const;
+	bignum operator<<(size_t shamt) const &;
+	bignum operator<<(size_t shamt) &&;
 
 	/*! right shift */
-	bignum operator>>(size_t shamt) const;
+	bignum operator>>(size_t shamt) const &;
+	bignum operator>>(size_t shamt) &&;
 
 	/*! bitwise and */
-	bignum operator&(const bignum &operand) const;
+	bignum operator&(const bignum &operand) const &;
+	bignum operator&(const bignum &operand) &&;
 
 	/*! bitwise or */
-	bignum operator|(const bignum &operand) const;
+	bignum operator|(const bignum &operand) const &;
+	bignum operator|(const bignum &operand) &&;
 
 	/*! bitwise xor */
-	bignum operator^(const bignum &operand) const;
+	bignum operator^(const bignum &operand) const &;
+	bignum operator^(const bignum &operand) &&;
 
 	/*! bitwise not */
-	bignum operator~() const;
+	bignum operator~() const &;
+	bignum operator~() &&;
 
 	/*! negate */
-	bignum operator-() const;
+	bignum operator-() const &;
+	bignum operator-() &&;
 
 
 	/*----------------------.
@@ -249,19 +493,27 @@ struct bignum
 	`-------------------------*/
 
 	/*! base 2^limb_bits multiply */
-	static void mult(const bignum &multiplicand, const bignum multiplier, bignum &result);
+	static void mult(const bignum &multiplicand, const bignum &multiplier, bignum &result);
+
+	/*! base 2^limb_bits square */
+	static void sqr(const bignum &operand, bignum &result);
 
-	/*! base 2^limb_bits division */
+	/*! base 2^limb_bits division, quotient or remainder may be the dividend */
 	static void divrem(const bignum &dividend, const bignum &divisor, bignum &quotient, bignum &remainder);
 
+	/*! division by a nonzero 64-bit integer, returns the remainder, quotient may be the dividend */
+	static uint64_t divrem_1(const bignum &dividend, uint64_t divisor, bignum &quotient);
+
 	/*! multiply */
 	bignum operator*(const bignum &operand) const;
 
 	/*! division quotient */
-	bignum operator/(const bignum &divisor) const;
+	bignum operator/(const bignum &divisor) const &;
+	bignum operator/(const bignum &divisor) &&;
 
 	/*! division remainder */
-	bignum operator%(const bignum &divisor) const;
+	bignum operator%(const bignum &divisor) const &;
+	bignum operator%(const bignum &divisor) &&;
 
 	/*! multiply equals */
 	bignum& operator*=(const bignum &operand);
@@ -276,6 +528,91 @@ struct bignum
 	bignum pow(size_t exp) const;
 
 
+	/*---------------------------.
+	| built-in integer operands. |
+	`---------------------------*/
+
+	/*
+	 * Built-in integer operands run single limb kernels instead of being
+	 * converted to a bignum. Results keep the signedness and width of the
+	 * bignum operand. A negative operand n acts as -|n|: it swaps add and
+	 * subtract and subtracts the product or quotient from zero, which is
+	 * two's complement at fixed width and wraps at the limbs of the result
+	 * at variable width, as 0 - x does. Comparisons follow the sign of
+	 * a signed fixed width value, so it is below any n >= 0 when its
+	 * sign bit is set and only then above some n < 0; other values
+	 * compare their limbs unsigned. Division by zero gives a zero
+	 * quotient and leaves the dividend as the remainder, as divrem does.
+	 */
+
+	/*! enable for built-in integer types */
+	template <typename I, typename T>
+	using if_integral = typename std::enable_if<std::is_integral<I>::value, T>::type;
+
+	/*! result = operand + n, result may be operand */
+	static void add_1(const bignum &operand, uint64_t n, bignum &result);
+
+	/*! result = operand - n with borrow, result may be operand */
+	static void sub_1(const bignum &operand, uint64_t n, bignum &result);
+
+	/*! result = operand * n, result may be operand */
+	static void mul_1(const bignum &operand, uint64_t n, bignum &result);
+
+	/*! return dividend % divisor without a quotient, divisor != 0 */
+	static uint64_t mod_1(const bignum &dividend, uint64_t divisor);
+
+	/*! compare the limbs with n, returns -1, 0 or 1 */
+	int compare_ui(uint64_t n) const;
+
+	/*! integer add and subtract */
+	template <typename I> if_integral<I, bignum&> operator+=(I n);
+	template <typename I> if_integral<I, bignum&> operator-=(I n);
+	template <typename I> if_integral<I, bignum> operator+(I n) const &;
+	template <typename I> if_integral<I, bignum> operator+(I n) &&;
+	template <typename I> if_integral<I, bignum> operator-(I n) const &;
+	template <typename I> if_integral<I, bignum> operator-(I n) &&;
+
+	/*! integer multiply, divide and modulus */
+	template <typename I> if_integral<I, bignum&> operator*=(I n);
+	template <typename I> if_integral<I, bignum&> operator/=(I n);
+	template <typename I> if_integral<I, bignum&> operator%=(I n);
+	template <typename I> if_integral<I, bignum> operator*(I n) const &;
+	template <typename I> if_integral<I, bignum> operator*(I n) &&;
+	template <typename I> if_integral<I, bignum> operator/(I n) const &;
+	template <typename I> if_integral<I, bignum> operator/(I n) &&;
+	template <typename I> if_integral<I, bignum> operator%(I n) const &;
+	template <typename I> if_integral<I, bignum> operator%(I n) &&;
+
+	/*! integer comparisons */
+	template <typename I> if_integral<I, int> compare(I n) const;
+	template <typename I> if_integral<I, bool> operator==(I n) const { return compare(n) == 0; }
+	template <typename I> if_integral<I, bool> operator!=(I n) const { return compare(n) != 0; }
+	template <typename I> if_integral<I, bool> operator<(I n) const { return compare(n) < 0; }
+	template <typename I> if_integral<I, bool> operator<=(I n) const { return compare(n) <= 0; }
+	template <typename I> if_integral<I, bool> operator>(I n) const { return compare(n) > 0; }
+	template <typename I> if_integral<I, bool> operator>=(I n) const { return compare(n) >= 0; }
+
+
+	/*-------------------.
+	| fused operations.  |
+	`-------------------*/
+
+	/*! result += multiplicand * multiplier without a product temporary */
+	static void addmul(const bignum &multiplicand, const bignum &multiplier, bignum &result);
+
+	/*! result -= multiplicand * multiplier without a product temporary */
+	static void submul(const bignum &multiplicand, const bignum &multiplier, bignum &result);
+
+	/*! result = multiplicand * multiplier % divisor with one scratch buffer */
+	static void mulmod(const bignum &multiplicand, const bignum &multiplier, const bignum &divisor, bignum &result);
+
+	/*! result = (operand << shamt) | other in one pass */
+	static void shl_or(const bignum &operand, size_t shamt, const bignum &other, bignum &result);
+
+	/*! start a lazy expression that is evaluated on assignment */
+	bignum_leaf lazy() const;
+
+
 	/*-------------------.
 	| string conversion. |
 	`-------------------*/
@@ -286,8 +623,530 @@ struct bignum
 	/*! convert bignum from string */
 	void from_string(const char *str, size_t len, size_t radix);
 
+	/*! return the exact number of characters to_string produces */
+	size_t to_chars_size(size_t radix = 10) const;
+
+	/*! write to_string characters to [first, last), returns the end or nullptr if they do not fit */
+	char* to_chars(char *first, char *last, size_t radix = 10) const;
+
+	/*! parse a run of digits from [first, last), returns the end or nullptr if there are none */
+	const char* from_chars(const char *first, const char *last, size_t radix = 0);
+
+	/*! write decimal digits to a stream without building the string */
+	void write_decimal(std::ostream &os) const;
+
+	/*! write digits to a file without building the string, false on error */
+	bool write_to(FILE *f, size_t radix = 10) const;
+
+	/*! set threads used for radix 10 conversion, 0 selects all cores */
+	static void set_conversion_threads(unsigned n);
+
+	/*! return threads used for radix 10 conversion */
+	static unsigned conversion_threads();
+
+	/*! set limb memory functions for new blocks, nullptr restores operator new and delete */
+	static void set_memory_functions(alloc_func alloc, free_func free);
+
+	/*! return the limb memory functions */
+	static void get_memory_functions(alloc_func *alloc, free_func *free);
+
+};
+
+/*! write decimal digits to a stream */
+std::ostream& operator<<(std::ostream &os, const bignum &b);
+
+
+/*--------------------------.
+| bignum integer operands. |
+`--------------------------*/
+
+template <typename I>
+bignum::if_integral<I, bignum&> bignum::operator+=(I n)
+{
+	if (_neg(n)) sub_1(*this, _mag(n), *this);
+	else add_1(*this, _mag(n), *this);
+	return *this;
+}
+
+template <typename I>
+bignum::if_integral<I, bignum&> bignum::operator-=(I n)
+{
+	if (_neg(n)) add_1(*this, _mag(n), *this);
+	else sub_1(*this, _mag(n), *this);
+	return *this;
+}
+
+template <typename I>
+bignum::if_integral<I, bignum> bignum::operator+(I n) const &
+{
+	bignum result(s, bits);
+	if (_neg(n)) sub_1(*this, _mag(n), result);
+	else add_1(*this, _mag(n), result);
+	return result;
+}
+
+template <typename I>
+bignum::if_integral<I, bignum> bignum::operator+(I n) &&
+{
+	return std::move(*this += n);
+}
+
+template <typename I>
+bignum::if_integral<I, bignum> bignum::operator-(I n) const &
+{
+	bignum result(s, bits);
+	if (_neg(n)) add_1(*this, _mag(n), result);
+	else sub_1(*this, _mag(n), result);
+	return result;
+}
+
+template <typename I>
+bignum::if_integral<I, bignum> bignum::operator-(I n) &&
+{
+	return std::move(*this -= n);
+}
+
+template <typename I>
+bignum::if_integral<I, bignum&> bignum::operator*=(I n)
+{
+	mul_1(*this, _mag(n), *this);
+	if (_neg(n)) _negate_wrap();
+	return *this;
+}
+
+template <typename I>
+bignum::if_integral<I, bignum&> bignum::operator/=(I n)
+{
+	if (n == 0) return *this = 0;
+	divrem_1(*this, _mag(n), *this);
+	if (_neg(n)) _negate_wrap();
+	return *this;
+}
+
+template <typename I>
+bignum::if_integral<I, bignum&> bignum::operator%=(I n)
+{
+	if (n != 0) _assign_ui(mod_1(*this, _mag(n)));
+	return *this;
+}
+
+template <typename I>
+bignum::if_integral<I, bignum> bignum::operator*(I n) const &
+{
+	bignum result(s, bits);
+	mul_1(*this, _mag(n), result);
+	if (_neg(n)) result._negate_wrap();
+	return result;
+}
+
+template <typename I>
+bignum::if_integral<I, bignum> bignum::operator*(I n) &&
+{
+	return std::move(*this *= n);
+}
+
+template <typename I>
+bignum::if_integral<I, bignum> bignum::operator/(I n) const &
+{
+	bignum quotient(0, s, bits);
+	if (n == 0) return quotient;
+	divrem_1(*this, _mag(n), quotient);
+	if (_neg(n)) quotient._negate_wrap();
+	return quotient;
+}
+
+template <typename I>
+bignum::if_integral<I, bignum> bignum::operator/(I n) &&
+{
+	return std::move(*this /= n);
+}
+
+template <typename I>
+bignum::if_integral<I, bignum> bignum::operator%(I n) const &
+{
+	if (n == 0) return *this;
+	bignum remainder(0, s, bits);
+	remainder._assign_ui(mod_1(*this, _mag(n)));
+	return remainder;
+}
+
+template <typename I>
+bignum::if_integral<I, bignum> bignum::operator%(I n) &&
+{
+	return std::move(*this %= n);
+}
+
+template <typename I>
+bignum::if_integral<I, int> bignum::compare(I n) const
+{
+	if (_neg(n)) return _compare_neg(_mag(n));
+	return sign_bit() ? -1 : compare_ui(_mag(n));
+}
+
+/*------------------.
+| bignum_divisor.   |
+`------------------*/
+
+/*
+ * bignum_divisor holds a divisor normalized once for repeated division:
+ * the shifted limbs, the shift, the reciprocal of the top limb and, for
+ * exact division, the odd part of the divisor with the inverse of its
+ * low limb modulo 2^limb_bits.
+ */
+
+struct bignum_divisor
+{
+	typedef bignum::ulimb_t ulimb_t;
+
+	/*! the divisor */
+	bignum d;
+
+	/*! divisor shifted left so that its top bit is set */
+	bignum::limb_buffer vn;
+
+	/*! normalization shift and reciprocal of the top normalized limb */
+	int shift;
+	ulimb_t dinv;
+
+	/*! divisor shifted right by its trailing zeros and inverse of its low limb */
+	bignum::limb_buffer vo;
+	size_t tz;
+	ulimb_t binv;
+
+	/*! construct from divisor */
+	bignum_divisor(const bignum &divisor);
+
+	/*! quotient and remainder */
+	void divrem(const bignum &dividend, bignum &quotient, bignum &remainder) const;
+
+	/*! remainder */
+	bignum mod(const bignum &dividend) const;
+
+	/*! quotient of a dividend known to be a multiple of the divisor */
+	bignum divexact(const bignum &dividend) const;
+};
+
+/*------------------.
+| bignum_barrett.   |
+`------------------*/
+
+/*
+ * bignum_barrett reduces by a fixed size modulus of n limbs with the high
+ * half of a product by the precomputed mu = floor(2^(2 * n * limb_bits) / d)
+ * and the low half of a product by d, using stack scratch. Dividends longer
+ * than 2n limbs and moduli of karatsuba_threshold limbs or more, where half
+ * products no longer beat division, fall back to bignum_divisor.
+ */
+
+struct bignum_barrett
+{
+	typedef bignum::ulimb_t ulimb_t;
+
+	/*! the divisor and its reciprocal */
+	bignum_divisor d;
+	bignum mu;
+
+	/*! construct from divisor */
+	bignum_barrett(const bignum &divisor);
+
+	/*! quotient and remainder */
+	void divrem(const bignum &dividend, bignum &quotient, bignum &remainder) const;
+
+	/*! remainder */
+	bignum mod(const bignum &dividend) const;
+};
+
+/*------------------.
+| bignum_arena.     |
+`------------------*/
+
+/*
+ * bignum_arena is a scoped bump allocator for limb storage. While it is
+ * the innermost arena on the thread that constructed it, limb storage
+ * allocated on that thread is carved from its chunks, which come from
+ * the limb memory functions or an initial caller buffer. Freeing is a
+ * no-op except that the most recent allocations are rewound, and the
+ * destructor releases every chunk at once.
+ *
+ * Values allocated in an arena must not outlive it or be freed on
+ * another thread. Copy results into values allocated in a heap_scope
+ * before the arena is destroyed. Arenas nest and must be destroyed in
+ * reverse order of construction.
+ */
+
+struct bignum_arena
+{
+	/*! suspends arenas on this thread so that allocation uses the heap */
+	struct heap_scope
+	{
+		bignum_arena *saved;
+
+		heap_scope();
+		~heap_scope();
+		heap_scope(const heap_scope &) = delete;
+		heap_scope& operator=(const heap_scope &) = delete;
+	};
+
+	/*! chunk header, the caller buffer is the only chunk not freed */
+	struct chunk
+	{
+		chunk *next;
+		char *base;
+		size_t size;
+		bignum::free_func free;
+	};
+
+	enum { align = 16 };
+
+	chunk first;
+	chunk *chunks;
+	char *cur, *end;
+	size_t next_size;
+	bignum_arena *saved;
+
+	/*! construct an arena growing by chunks of at least chunk_size bytes */
+	bignum_arena(size_t chunk_size = 65536);
+
+	/*! construct an arena that allocates from buf before adding chunks */
+	bignum_arena(void *buf, size_t size, size_t chunk_size = 65536);
+
+	/*! release all chunks and restore the enclosing arena */
+	~bignum_arena();
+
+	bignum_arena(const bignum_arena &) = delete;
+	bignum_arena& operator=(const bignum_arena &) = delete;
+
+	/*! allocate size bytes aligned to align */
+	void* allocate(size_t size);
+
+	/*! rewind if p is the most recent allocation */
+	void deallocate(void *p, size_t size);
+
+	/*! test whether p lies in one of the chunks */
+	bool owns(const void *p) const;
+
+	/*! return the bytes held in chunks other than the caller buffer */
+	size_t chunk_bytes() const;
 };
 
+/*------------------.
+| bignum_expr.      |
+`------------------*/
+
+/*
+ * Expressions started with bignum::lazy() build a tree of operand
+ * references that is evaluated when it is assigned or converted to a
+ * bignum. Common shapes map onto the fused operations:
+ *
+ *   r = a.lazy() * b + c;             addmul
+ *   r = a.lazy() * b - c.lazy() * d;  mult and submul
+ *   r = a.lazy() * b % m;             mulmod
+ *   r = (a.lazy() << k) | b;          shl_or
+ *
+ * Other shapes evaluate their operands with the eager operators. Nodes
+ * refer to their operands, so an expression must be evaluated in the
+ * full expression that creates it and not be kept with auto.
+ */
+
+struct bignum_op
+{
+	struct mul {};
+	struct add {};
+	struct sub {};
+	struct mod {};
+	struct shl {};
+	struct bor {};
+};
+
+struct bignum_leaf
+{
+	const bignum &v;
+};
+
+template <typename Op, typename L, typename R>
+struct bignum_expr
+{
+	L l;
+	R r;
+};
+
+inline bignum_leaf bignum::lazy() const { return bignum_leaf{*this}; }
+
+/*! maps an operand type to its node type, lazy if it starts an expression */
+template <typename T> struct bignum_term { enum { valid = 0, lazy = 0 }; };
+template <> struct bignum_term<bignum> { enum { valid = 1, lazy = 0 }; typedef bignum_leaf type; };
+template <> struct bignum_term<bignum_leaf> { enum { valid = 1, lazy = 1 }; typedef bignum_leaf type; };
+template <typename Op, typename L, typename R> struct bignum_term<bignum_expr<Op, L, R>> {
+	enum { valid = 1, lazy = 1 }; typedef bignum_expr<Op, L, R> type;
+};
+
+/*! node type of a binary operator, defined when an operand is lazy */
+template <typename Op, typename A, typename B, bool = bignum_term<A>::valid &&
+	bignum_term<B>::valid && (bignum_term<A>::lazy || bignum_term<B>::lazy)>
+struct bignum_binary {};
+
+template <typename Op, typename A, typename B>
+struct bignum_binary<Op, A, B, true>
+{
+	typedef bignum_expr<Op, typename bignum_term<A>::type, typename bignum_term<B>::type> type;
+};
+
+inline bignum_leaf bignum_node(const bignum &v) { return bignum_leaf{v}; }
+inline const bignum_leaf& bignum_node(const bignum_leaf &v) { return v; }
+template <typename Op, typename L, typename R>
+const bignum_expr<Op, L, R>& bignum_node(const bignum_expr<Op, L, R> &e) { return e; }
+
+template <typename A, typename B>
+typename bignum_binary<bignum_op::mul, A, B>::type operator*(const A &a, const B &b) { return { bignum_node(a), bignum_node(b) }; }
+template <typename A, typename B>
+typename bignum_binary<bignum_op::add, A, B>::type operator+(const A &a, const B &b) { return { bignum_node(a), bignum_node(b) }; }
+template <typename A, typename B>
+typename bignum_binary<bignum_op::sub, A, B>::type operator-(const A &a, const B &b) { return { bignum_node(a), bignum_node(b) }; }
+template <typename A, typename B>
+typename bignum_binary<bignum_op::mod, A, B>::type operator%(const A &a, const B &b) { return { bignum_node(a), bignum_node(b) }; }
+template <typename A, typename B>
+typename bignum_binary<bignum_op::bor, A, B>::type operator|(const A &a, const B &b) { return { bignum_node(a), bignum_node(b) }; }
+
+/* temporary left operands take these over the rvalue member operators */
+template <typename B>
+typename bignum_binary<bignum_op::mul, bignum, B>::type operator*(bignum &&a, const B &b) { return { bignum_node(a), bignum_node(b) }; }
+template <typename B>
+typename bignum_binary<bignum_op::add, bignum, B>::type operator+(bignum &&a, const B &b) { return { bignum_node(a), bignum_node(b) }; }
+template <typename B>
+typename bignum_binary<bignum_op::sub, bignum, B>::type operator-(bignum &&a, const B &b) { return { bignum_node(a), bignum_node(b) }; }
+template <typename B>
+typename bignum_binary<bignum_op::mod, bignum, B>::type operator%(bignum &&a, const B &b) { return { bignum_node(a), bignum_node(b) }; }
+template <typename B>
+typename bignum_binary<bignum_op::bor, bignum, B>::type operator|(bignum &&a, const B &b) { return { bignum_node(a), bignum_node(b) }; }
+
+template <typename A>
+typename std::enable_if<bignum_term<A>::lazy, bignum_expr<bignum_op::shl, A, size_t>>::type
+operator<<(const A &a, size_t shamt) { return { a, shamt }; }
+
+/*! operand values, leaves by reference and nested nodes evaluated */
+inline const bignum& bignum_value(const bignum_leaf &t) { return t.v; }
+template <typename Op, typename L, typename R>
+bignum bignum_value(const bignum_expr<Op, L, R> &e) { return bignum(e); }
+
+/*! test whether fused evaluation into d matches the eager operators */
+inline bool bignum_fusable(const bignum &d, const bignum &a, const bignum &b, const bignum &c)
+{
+	return !d.bits && !a.bits && !b.bits && !c.bits && &d != &a && &d != &b;
+}
+
+/* generic nodes use the eager operators */
+
+template <typename L, typename R>
+void bignum_eval(bignum &d, const bignum_expr<bignum_op::mul, L, R> &e) { d = bignum_value(e.l) * bignum_value(e.r); }
+template <typename L, typename R>
+void bignum_eval(bignum &d, const bignum_expr<bignum_op::add, L, R> &e) { d = bignum_value(e.l) + bignum_value(e.r); }
+template <typename L, typename R>
+void bignum_eval(bignum &d, const bignum_expr<bignum_op::sub, L, R> &e) { d = bignum_value(e.l) - bignum_value(e.r); }
+template <typename L, typename R>
+void bignum_eval(bignum &d, const bignum_expr<bignum_op::mod, L, R> &e) { d = bignum_value(e.l) % bignum_value(e.r); }
+template <typename L, typename R>
+void bignum_eval(bignum &d, const bignum_expr<bignum_op::bor, L, R> &e) { d = bignum_value(e.l) | bignum_value(e.r); }
+template <typename L>
+void bignum_eval(bignum &d, const bignum_expr<bignum_op::shl, L, size_t> &e) { d = bignum_value(e.l) << e.r; }
+
+/* fused shapes */
+
+/*! d = a * b + c */
+template <typename A, typename B, typename C>
+void bignum_eval(bignum &d, const bignum_expr<bignum_op::add, bignum_expr<bignum_op::mul, A, B>, C> &e)
+{
+	const bignum &a = bignum_value(e.l.l), &b = bignum_value(e.l.r), &c = bignum_value(e.r);
+	if (!bignum_fusable(d, a, b, c)) {
+		d = a * b + c;
+		return;
+	}
+	d = c;
+	bignum::addmul(a, b, d);
+}
+
+/*! d = c + a * b */
+template <typename A, typename B, typename C>
+void bignum_eval(bignum &d, const bignum_expr<bignum_op::add, C, bignum_expr<bignum_op::mul, A, B>> &e)
+{
+	const bignum &c = bignum_value(e.l), &a = bignum_value(e.r.l), &b = bignum_value(e.r.r);
+	if (!bignum_fusable(d, a, b, c)) {
+		d = c + a * b;
+		return;
+	}
+	d = c;
+	bignum::addmul(a, b, d);
+}
+
+/*! d = a * b + x * y */
+template <typename A, typename B, typename X, typename Y>
+void bignum_eval(bignum &d, const bignum_expr<bignum_op::add, bignum_expr<bignum_op::mul, A, B>,
+	bignum_expr<bignum_op::mul, X, Y>> &e)
+{
+	const bignum &a = bignum_value(e.l.l), &b = bignum_value(e.l.r);
+	const bignum &x = bignum_value(e.r.l), &y = bignum_value(e.r.r);
+	if (!bignum_fusable(d, x, y, a) || b.bits) {
+		d = a * b + x * y;
+		return;
+	}
+	bignum::mult(a, b, d);
+	bignum::addmul(x, y, d);
+}
+
+/*! d = c - a * b */
+template <typename A, typename B, typename C>
+void bignum_eval(bignum &d, const bignum_expr<bignum_op::sub, C, bignum_expr<bignum_op::mul, A, B>> &e)
+{
+	const bignum &c = bignum_value(e.l), &a = bignum_value(e.r.l), &b = bignum_value(e.r.r);
+	if (!bignum_fusable(d, a, b, c)) {
+		d = c - a * b;
+		return;
+	}
+	d = c;
+	bignum::submul(a, b, d);
+}
+
+/*! d = a * b - x * y */
+template <typename A, typename B, typename X, typename Y>
+void bignum_eval(bignum &d, const bignum_expr<bignum_op::sub, bignum_expr<bignum_op::mul, A, B>,
+	bignum_expr<bignum_op::mul, X, Y>> &e)
+{
+	const bignum &a = bignum_value(e.l.l), &b = bignum_value(e.l.r);
+	const bignum &x = bignum_value(e.r.l), &y = bignum_value(e.r.r);
+	if (!bignum_fusable(d, x, y, a) || b.bits) {
+		d = a * b - x * y;
+		return;
+	}
+	bignum::mult(a, b, d);
+	bignum::submul(x, y, d);
+}
+
+/*! d = a * b % m */
+template <typename A, typename B, typename M>
+void bignum_eval(bignum &d, const bignum_expr<bignum_op::mod, bignum_expr<bignum_op::mul, A, B>, M> &e)
+{
+	bignum::mulmod(bignum_value(e.l.l), bignum_value(e.l.r), bignum_value(e.r), d);
+}
+
+/*! d = (a << k) | b */
+template <typename A, typename B>
+void bignum_eval(bignum &d, const bignum_expr<bignum_op::bor, bignum_expr<bignum_op::shl, A, size_t>, B> &e)
+{
+	bignum::shl_or(bignum_value(e.l.l), e.l.r, bignum_value(e.r), d);
+}
+
+template <typename Op, typename L, typename R>
+bignum::bignum(const bignum_expr<Op, L, R> &e) : bignum()
+{
+	bignum_eval(*this, e);
+}
+
+template <typename Op, typename L, typename R>
+bignum& bignum::operator=(const bignum_expr<Op, L, R> &e)
+{
+	bignum_eval(*this, e);
+	return *this;
+}
+
 /*------------------.
 | inttype.          |
 `------------------*/
@@ -320,9 +1179,18 @@ struct Uint32 : inttype {
 struct Sint32 : inttype {
 	Sint32(int32_t v) : inttype(v, is_signed(), 32) {}
 };
+#if BIGNUM_LIMB_BITS == 64
+struct Uint64 : inttype {
+	Uint64(uint64_t v) : inttype(v, is_unsigned(), 64) {}
+};
+struct Sint64 : inttype {
+	Sint64(int64_t v) : inttype(uint64_t(v), is_signed(), 64) {}
+};
+#else
 struct Uint64 : inttype {
 	Uint64(uint64_t v) : inttype({ uint32_t(v), uint32_t(v >> 32) }, is_unsigned(), 64) {}
 };
 struct Sint64 : inttype {
 	Sint64(int64_t v) : inttype({ uint32_t(v), uint32_t(v >> 32) }, is_signed(), 64) {}
 };
+#endif
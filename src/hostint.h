@@ -24,6 +24,11 @@ struct hostint {
 	>::type type;
 };
 
+#if defined (__SIZEOF_INT128__)
+template<> struct hostint<128, false> { typedef unsigned __int128 type; };
+template<> struct hostint<128, true> { typedef __int128 type; };
+#endif
+
 /*!
  * static type information container for log2 of integer bit widths
  */
@@ -0,0 +1,194 @@
+// See LICENSE.md
+
+#include "mpn.h"
+
+#if defined (__GNUC__) && defined (__x86_64__)
+#include <cpuid.h>
+#define MPN_X86_64_ASM 1
+#endif
+
+
+/*------------------.
+| portable.         |
+`------------------*/
+
+template <typename L> static L _add_n(L *r, const L *a, const L *b, size_t n) { return mpn<L>::add_n(r, a, b, n); }
+template <typename L> static L _sub_n(L *r, const L *a, const L *b, size_t n) { return mpn<L>::sub_n(r, a, b, n); }
+template <typename L> static L _mul_1(L *r, const L *a, size_t n, L b) { return mpn<L>::mul_1(r, a, n, b); }
+template <typename L> static L _addmul_1(L *r, const L *a, size_t n, L b) { return mpn<L>::addmul_1(r, a, n, b); }
+template <typename L> static L _submul_1(L *r, const L *a, size_t n, L b) { return mpn<L>::submul_1(r, a, n, b); }
+template <typename L> static L _lshift(L *r, const L *a, size_t n, unsigned s) { return mpn<L>::lshift(r, a, n, s); }
+template <typename L> static L _rshift(L *r, const L *a, size_t n, unsigned s) { return mpn<L>::rshift(r, a, n, s); }
+
+template <typename L>
+static const mpn_ops<L>& _portable_ops()
+{
+	static const mpn_ops<L> ops = {
+		_add_n<L>, _sub_n<L>, _mul_1<L>, _addmul_1<L>, _submul_1<L>, _lshift<L>, _rshift<L>, "portable"
+	};
+	return ops;
+}
+
+
+/*------------------.
+| x86-64 bmi2+adx.  |
+`------------------*/
+
+#if defined (MPN_X86_64_ASM)
+
+/*
+ * The loops below handle two limbs per iteration and index from -n up
+ * to zero so that lea and jrcxz can advance and test the counter
+ * without touching the carry flags. An odd leading limb is handled by
+ * the portable code and its carry enters the loop in c.
+ */
+
+/*! r[0..n) = a[0..n) * b using mulx, returns high limb */
+__attribute__((target("bmi2")))
+static uint64_t _mul_1_bmi2(uint64_t *r, const uint64_t *a, size_t n, uint64_t b)
+{
+	uint64_t c = 0, lo, hi;
+	if (n & 1) {
+		c = mpn<uint64_t>::mul_1(r++, a++, 1, b);
+	}
+	if (n < 2) return c;
+	ptrdiff_t i = -ptrdiff_t(n & ~size_t(1));
+	r -= i;
+	a -= i;
+	__asm__ (
+		"xor %k[lo], %k[lo]\n\t"
+		"1:\n\t"
+		"mulx (%[a],%[i],8), %[lo], %[hi]\n\t"
+		"adc %[c], %[lo]\n\t"
+		"mov %[lo], (%[r],%[i],8)\n\t"
+		"mulx 8(%[a],%[i],8), %[lo], %[c]\n\t"
+		"adc %[hi], %[lo]\n\t"
+		"mov %[lo], 8(%[r],%[i],8)\n\t"
+		"lea 2(%[i]), %[i]\n\t"
+		"jrcxz 2f\n\t"
+		"jmp 1b\n\t"
+		"2:\n\t"
+		"adc $0, %[c]\n\t"
+		: [c] "+&r" (c), [i] "+&c" (i), [lo] "=&r" (lo), [hi] "=&r" (hi)
+		: [a] "r" (a), [r] "r" (r), "d" (b)
+		: "cc", "memory");
+	return c;
+}
+
+/*! r[0..n) += a[0..n) * b using mulx, adcx and adox, returns carry */
+__attribute__((target("bmi2,adx")))
+static uint64_t _addmul_1_adx(uint64_t *r, const uint64_t *a, size_t n, uint64_t b)
+{
+	uint64_t c = 0, z, lo, hi;
+	if (n & 1) {
+		c = mpn<uint64_t>::addmul_1(r++, a++, 1, b);
+	}
+	if (n < 2) return c;
+	ptrdiff_t i = -ptrdiff_t(n & ~size_t(1));
+	r -= i;
+	a -= i;
+	__asm__ (
+		"xor %k[z], %k[z]\n\t"
+		"1:\n\t"
+		"mulx (%[a],%[i],8), %[lo], %[hi]\n\t"
+		"adcx %[c], %[lo]\n\t"
+		"adox (%[r],%[i],8), %[lo]\n\t"
+		"mov %[lo], (%[r],%[i],8)\n\t"
+		"mulx 8(%[a],%[i],8), %[lo], %[c]\n\t"
+		"adcx %[hi], %[lo]\n\t"
+		"adox 8(%[r],%[i],8), %[lo]\n\t"
+		"mov %[lo], 8(%[r],%[i],8)\n\t"
+		"lea 2(%[i]), %[i]\n\t"
+		"jrcxz 2f\n\t"
+		"jmp 1b\n\t"
+		"2:\n\t"
+		"adcx %[z], %[c]\n\t"
+		"adox %[z], %[c]\n\t"
+		: [c] "+&r" (c), [i] "+&c" (i), [z] "=&r" (z), [lo] "=&r" (lo), [hi] "=&r" (hi)
+		: [a] "r" (a), [r] "r" (r), "d" (b)
+		: "cc", "memory");
+	return c;
+}
+
+/*
+ * submul_1 adds the product to the complement of r since sbb would
+ * clobber the overflow flag: ~(~r + a * b) == r - a * b, with the
+ * carry of the sum equal to the borrow of the difference.
+ */
+
+/*! r[0..n) -= a[0..n) * b using mulx, adcx and adox, returns borrow */
+__attribute__((target("bmi2,adx")))
+static uint64_t _submul_1_adx(uint64_t *r, const uint64_t *a, size_t n, uint64_t b)
+{
+	uint64_t c = 0, z, lo, hi, t;
+	if (n & 1) {
+		c = mpn<uint64_t>::submul_1(r++, a++, 1, b);
+	}
+	if (n < 2) return c;
+	ptrdiff_t i = -ptrdiff_t(n & ~size_t(1));
+	r -= i;
+	a -= i;
+	__asm__ (
+		"xor %k[z], %k[z]\n\t"
+		"1:\n\t"
+		"mulx (%[a],%[i],8), %[lo], %[hi]\n\t"
+		"adcx %[c], %[lo]\n\t"
+		"mov (%[r],%[i],8), %[t]\n\t"
+		"not %[t]\n\t"
+		"adox %[lo], %[t]\n\t"
+		"not %[t]\n\t"
+		"mov %[t], (%[r],%[i],8)\n\t"
+		"mulx 8(%[a],%[i],8), %[lo], %[c]\n\t"
+		"adcx %[hi], %[lo]\n\t"
+		"mov 8(%[r],%[i],8), %[t]\n\t"
+		"not %[t]\n\t"
+		"adox %[lo], %[t]\n\t"
+		"not %[t]\n\t"
+		"mov %[t], 8(%[r],%[i],8)\n\t"
+		"lea 2(%[i]), %[i]\n\t"
+		"jrcxz 2f\n\t"
+		"jmp 1b\n\t"
+		"2:\n\t"
+		"adcx %[z], %[c]\n\t"
+		"adox %[z], %[c]\n\t"
+		: [c] "+&r" (c), [i] "+&c" (i), [z] "=&r" (z), [lo] "=&r" (lo), [hi] "=&r" (hi), [t] "=&r" (t)
+		: [a] "r" (a), [r] "r" (r), "d" (b)
+		: "cc", "memory");
+	return c;
+}
+
+static const mpn_ops<uint64_t> _adx_ops = {
+	_add_n<uint64_t>, _sub_n<uint64_t>, _mul_1_bmi2, _addmul_1_adx, _submul_1_adx,
+	_lshift<uint64_t>, _rshift<uint64_t>, "bmi2+adx"
+};
+
+/*! test CPUID leaf 7 for BMI2 (ebx bit 8) and ADX (ebx bit 19) */
+static bool _has_bmi2_adx()
+{
+	unsigned a, b, c, d;
+	if (__get_cpuid_max(0, nullptr) < 7) return false;
+	__cpuid_count(7, 0, a, b, c, d);
+	return (b & (1u << 8)) && (b & (1u << 19));
+}
+
+#endif
+
+
+/*------------------.
+| dispatch.         |
+`------------------*/
+
+template<> const mpn_ops<uint32_t>& mpn_ops<uint32_t>::get()
+{
+	return _portable_ops<uint32_t>();
+}
+
+template<> const mpn_ops<uint64_t>& mpn_ops<uint64_t>::get()
+{
+#if defined (MPN_X86_64_ASM)
+	static const mpn_ops<uint64_t> &ops = _has_bmi2_adx() ? _adx_ops : _portable_ops<uint64_t>();
+	return ops;
+#else
+	return _portable_ops<uint64_t>();
+#endif
+}
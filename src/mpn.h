@@ -0,0 +1,489 @@
+// See LICENSE.md
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "bits.h"
+#include "hostint.h"
+
+#if defined (_MSC_VER) && (defined (_M_X64) || defined (_M_IX86))
+#include <intrin.h>
+#define MPN_ADDCARRY_U32 1
+#if defined (_M_X64)
+#define MPN_ADDCARRY_U64 1
+#endif
+#elif defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+#include <x86intrin.h>
+#define MPN_ADDCARRY_U32 1
+#if defined (__x86_64__)
+#define MPN_ADDCARRY_U64 1
+#endif
+#endif
+
+/*------------------.
+| mpn.              |
+`------------------*/
+
+/*
+ * mpn is a set of primitives operating on little endian limb vectors.
+ * The functions return the carry, borrow or the bits shifted out and
+ * allow r to be the same span as a (or b). The inline versions here
+ * are used directly by wideint and by mpn_ops for the portable path.
+ */
+
+template <typename L>
+struct mpn
+{
+	enum { limb_bits = sizeof(L) << 3 };
+
+	typedef typename hostint<limb_bits*2, false>::type udlimb_t;
+
+	/*! r = a + b + c, c <= 1, returns carry */
+	static inline L addc(L a, L b, L c, L *r)
+	{
+		L s = L(a + b), t = L(s + c);
+		*r = t;
+		return L((s < a) | (t < s));
+	}
+
+	/*! r = a - b - c, c <= 1, returns borrow */
+	static inline L subc(L a, L b, L c, L *r)
+	{
+		L s = L(a - b), t = L(s - c);
+		*r = t;
+		return L((s > a) | (t > s));
+	}
+
+	/*! return low limb of a * b and store the high limb in hi */
+	static inline L umul(L a, L b, L *hi)
+	{
+		udlimb_t p = udlimb_t(a) * b;
+		*hi = L(p >> limb_bits);
+		return L(p);
+	}
+
+	/*! r[0..n) = a[0..n) + b[0..n), returns carry */
+	static inline L add_n(L *r, const L *a, const L *b, size_t n)
+	{
+		L c = 0;
+		for (size_t i = 0; i < n; i++) {
+			c = addc(a[i], b[i], c, r + i);
+		}
+		return c;
+	}
+
+	/*! r[0..n) = a[0..n) - b[0..n), returns borrow */
+	static inline L sub_n(L *r, const L *a, const L *b, size_t n)
+	{
+		L c = 0;
+		for (size_t i = 0; i < n; i++) {
+			c = subc(a[i], b[i], c, r + i);
+		}
+		return c;
+	}
+
+	/*! r[0..n) = a[0..n) + c, returns carry */
+	static inline L add_1(L *r, const L *a, size_t n, L c)
+	{
+		for (size_t i = 0; i < n; i++) {
+			L t = L(a[i] + c);
+			c = t < c;
+			r[i] = t;
+		}
+		return c;
+	}
+
+	/*! r[0..n) = a[0..n) - c, returns borrow */
+	static inline L sub_1(L *r, const L *a, size_t n, L c)
+	{
+		for (size_t i = 0; i < n; i++) {
+			L s = a[i];
+			r[i] = L(s - c);
+			c = s < c;
+		}
+		return c;
+	}
+
+	/*! r[0..n) = a[0..n) * b, returns high limb */
+	static inline L mul_1(L *r, const L *a, size_t n, L b)
+	{
+		L c = 0;
+		for (size_t i = 0; i < n; i++) {
+			L hi, lo = umul(a[i], b, &hi);
+			lo = L(lo + c);
+			c = L(hi + (lo < c));
+			r[i] = lo;
+		}
+		return c;
+	}
+
+	/*! r[0..n) += a[0..n) * b, returns carry */
+	static inline L addmul_1(L *r, const L *a, size_t n, L b)
+	{
+		L c = 0;
+		for (size_t i = 0; i < n; i++) {
+			L hi, lo = umul(a[i], b, &hi);
+			lo = L(lo + c);
+			hi = L(hi + (lo < c));
+			L t = L(r[i] + lo);
+			c = L(hi + (t < lo));
+			r[i] = t;
+		}
+		return c;
+	}
+
+	/*! r[0..n) -= a[0..n) * b, returns borrow */
+	static inline L submul_1(L *r, const L *a, size_t n, L b)
+	{
+		L c = 0;
+		for (size_t i = 0; i < n; i++) {
+			L hi, lo = umul(a[i], b, &hi);
+			lo = L(lo + c);
+			hi = L(hi + (lo < c));
+			L s = r[i];
+			c = L(hi + (s < lo));
+			r[i] = L(s - lo);
+		}
+		return c;
+	}
+
+	/*! return floor((B^2 - 1) / d) - B for a normalized d, B = 2^limb_bits */
+	static inline L invert_limb(L d)
+	{
+		return L(((udlimb_t(L(~d)) << limb_bits) | L(~L(0))) / d);
+	}
+
+	/*! return (u1 * B + u0) / d and store the remainder in r, d normalized, u1 < d */
+	static inline L div_preinv(L u1, L u0, L d, L v, L *r)
+	{
+		/* Möller and Granlund, Improved division by invariant integers */
+		L q1, q0 = umul(v, u1, &q1);
+		L c = addc(q0, u0, 0, &q0);
+		q1 = L(q1 + u1 + 1 + c);
+		L t = L(u0 - L(q1 * d));
+		if (t > q0) {
+			q1 = L(q1 - 1);
+			t = L(t + d);
+		}
+		if (t >= d) {
+			q1 = L(q1 + 1);
+			t = L(t - d);
+		}
+		*r = t;
+		return q1;
+	}
+
+	/*! return the inverse of an odd d modulo B */
+	static inline L binvert_limb(L d)
+	{
+		/* Newton iteration doubles the correct low bits of the inverse */
+		L inv = d;
+		for (int i = 0; i < 5; i++) {
+			inv = L(inv * L(2 - L(d * inv)));
+		}
+		return inv;
+	}
+
+	/*! q[0..n) = a[0..n) / d, d != 0, returns remainder */
+	static inline L divrem_1(L *q, const L *a, size_t n, L d)
+	{
+		int s = clz(d);
+		d = L(d << s);
+		return divrem_1_preinv(q, a, n, d, s, invert_limb(d));
+	}
+
+	/*! q[0..n) = a[0..n) / (d >> s), d normalized with v = invert_limb(d), returns remainder */
+	static inline L divrem_1_preinv(L *q, const L *a, size_t n, L d, int s, L v)
+	{
+		L r = 0;
+		if (s == 0) {
+			for (size_t i = n; i-- > 0; ) {
+				q[i] = div_preinv(r, a[i], d, v, &r);
+			}
+			return r;
+		}
+		r = L(a[n - 1] >> (limb_bits - s));
+		for (size_t i = n - 1; i > 0; i--) {
+			L u0 = L((a[i] << s) | (a[i - 1] >> (limb_bits - s)));
+			q[i] = div_preinv(r, u0, d, v, &r);
+		}
+		q[0] = div_preinv(r, L(a[0] << s), d, v, &r);
+		return L(r >> s);
+	}
+
+	/*! return a[0..n) % d, d != 0 */
+	static inline L mod_1(const L *a, size_t n, L d)
+	{
+		int s = clz(d);
+		d = L(d << s);
+		L v = invert_limb(d), r = 0;
+		if (s == 0) {
+			for (size_t i = n; i-- > 0; ) {
+				div_preinv(r, a[i], d, v, &r);
+			}
+			return r;
+		}
+		r = L(a[n - 1] >> (limb_bits - s));
+		for (size_t i = n - 1; i > 0; i--) {
+			div_preinv(r, L((a[i] << s) | (a[i - 1] >> (limb_bits - s))), d, v, &r);
+		}
+		div_preinv(r, L(a[0] << s), d, v, &r);
+		return L(r >> s);
+	}
+
+	/*! load eight characters with the first in the low byte */
+	static inline uint64_t load_8(const char *p)
+	{
+		uint64_t x = 0;
+#if defined (__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		for (int i = 0; i < 8; i++) {
+			x |= uint64_t(uint8_t(p[i])) << (i << 3);
+		}
+#else
+		std::memcpy(&x, p, 8);
+#endif
+		return x;
+	}
+
+	/*! store eight characters with the first in the low byte */
+	static inline void store_8(char *p, uint64_t x)
+	{
+#if defined (__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		for (int i = 0; i < 8; i++) {
+			p[i] = char(x >> (i << 3));
+		}
+#else
+		std::memcpy(p, &x, 8);
+#endif
+	}
+
+	/*! return the value of eight decimal characters, first most significant */
+	static inline uint32_t unpack_dec_8(uint64_t x)
+	{
+		/* combine adjacent digits, then pairs of pairs in each 32-bit half */
+		x -= 0x3030303030303030ull;
+		x = x * 10 + (x >> 8);
+		x = ((x & 0x000000ff000000ffull) * (100 + (1000000ull << 32))
+			+ ((x >> 16) & 0x000000ff000000ffull) * (1 + (10000ull << 32))) >> 32;
+		return uint32_t(x);
+	}
+
+	/*! return eight decimal characters of v < 10^8, first in the low byte */
+	static inline uint64_t pack_dec_8(uint32_t v)
+	{
+		/* split into 4, 2 and 1 digit lanes with reciprocal multiplies */
+		uint64_t x = (v / 10000) | (uint64_t(v % 10000) << 32);
+		uint64_t h = ((x * 10486) >> 20) & 0x0000007f0000007full;
+		x = ((x - h * 100) << 16) + h;
+		h = ((x * 103) >> 10) & 0x000f000f000f000full;
+		x = h + ((x - h * 10) << 8);
+		return x + 0x3030303030303030ull;
+	}
+
+	/*! write the digits of v ending before p, zero padded to w, returns the first */
+	static inline char* put_dec(char *p, uint64_t v, size_t w)
+	{
+		char *e = p, top[8];
+
+		/* whole groups of eight digits, then the significant digits of the top group */
+		while (v >= 100000000) {
+			uint64_t q = v / 100000000;
+			p -= 8;
+			store_8(p, pack_dec_8(uint32_t(v - q * 100000000)));
+			v = q;
+		}
+		uint64_t x = pack_dec_8(uint32_t(v)), z = x - 0x3030303030303030ull;
+		size_t n = z ? 8 - (ctz(z) >> 3) : 1, k = size_t(e - p);
+		if (w > k + n) n = w - k < 8 ? w - k : 8;
+		store_8(top, x);
+		for (size_t i = 0; i < n; i++) {
+			*--p = top[7 - i];
+		}
+		while (size_t(e - p) < w) {
+			*--p = '0';
+		}
+		return p;
+	}
+
+	/*! return the value of eight hexadecimal characters, first most significant */
+	static inline uint32_t unpack_hex_8(uint64_t x)
+	{
+		/* '0'-'9' have bit 6 clear, 'a'-'f' and 'A'-'F' add 9 to the low nibble */
+		x = (x & 0x0f0f0f0f0f0f0f0full) + ((x >> 6) & 0x0101010101010101ull) * 9;
+		x = ((x & 0x000f000f000f000full) << 4) | ((x >> 8) & 0x000f000f000f000full);
+		x = ((x & 0x000000ff000000ffull) << 8) | ((x >> 16) & 0x000000ff000000ffull);
+		return uint32_t(((x & 0xffff) << 16) | ((x >> 32) & 0xffff));
+	}
+
+	/*! return the value of eight binary characters, first most significant */
+	static inline uint32_t unpack_bin_8(uint64_t x)
+	{
+		/* the multiply gathers byte j into bit 63 - j */
+		return uint32_t(((x & 0x0101010101010101ull) * 0x8040201008040201ull) >> 56);
+	}
+
+	/*! r[0..n) = hexadecimal (shift 4) or binary (shift 1) digits str[0..len) modulo B^rn, returns n */
+	static inline size_t set_str_2exp(L *r, size_t rn, const char *str, size_t len, unsigned shift)
+	{
+		const size_t per = limb_bits / shift;
+		const char *p = str + len;
+		size_t n = 0;
+
+		/* whole limbs from the little end of the string, eight digits at a time */
+		while (size_t(p - str) >= per && n < rn) {
+			L v = 0;
+			for (size_t k = 0; k < per; k += 8) {
+				p -= 8;
+				uint64_t x = load_8(p);
+				v = L(v | L(L(shift == 4 ? unpack_hex_8(x) : unpack_bin_8(x)) << (k * shift)));
+			}
+			r[n++] = v;
+		}
+
+		/* the remaining high digits form a partial limb */
+		if (p > str && n < rn) {
+			L v = 0;
+			for (const char *q = str; q < p; q++) {
+				uint32_t c = uint8_t(*q);
+				v = L((v << shift) | (shift == 4 ? (c & 0xf) + ((c >> 6) & 1) * 9 : c & 1));
+			}
+			r[n++] = v;
+		}
+		return n;
+	}
+
+	/*! return the end of the run of radix 2, 10 or 16 digits starting at p */
+	static inline const char* scan_digits(const char *p, const char *last, size_t radix)
+	{
+		for (; p < last; p++) {
+			unsigned c = uint8_t(*p);
+			bool digit = radix == 16 ? c - '0' < 10u || (c | 0x20) - 'a' < 6u : c - '0' < radix;
+			if (!digit) break;
+		}
+		return p;
+	}
+
+	/*! r[0..n) = a[0..n) << shamt, 0 < shamt < limb_bits, returns bits shifted out */
+	static inline L lshift(L *r, const L *a, size_t n, unsigned shamt)
+	{
+		L c = L(a[n - 1] >> (limb_bits - shamt));
+		for (size_t i = n - 1; i > 0; i--) {
+			r[i] = L((a[i] << shamt) | (a[i - 1] >> (limb_bits - shamt)));
+		}
+		r[0] = L(a[0] << shamt);
+		return c;
+	}
+
+	/*! r[0..n) = a[0..n) >> shamt, 0 < shamt < limb_bits, returns bits shifted out in the high end */
+	static inline L rshift(L *r, const L *a, size_t n, unsigned shamt)
+	{
+		L c = L(a[0] << (limb_bits - shamt));
+		for (size_t i = 0; i < n - 1; i++) {
+			r[i] = L((a[i] >> shamt) | (a[i + 1] << (limb_bits - shamt)));
+		}
+		r[n - 1] = L(a[n - 1] >> shamt);
+		return c;
+	}
+};
+
+#if defined (MPN_ADDCARRY_U32)
+template<> inline uint32_t mpn<uint32_t>::addc(uint32_t a, uint32_t b, uint32_t c, uint32_t *r)
+{
+	unsigned int t;
+	uint32_t co = _addcarry_u32((unsigned char)c, a, b, &t);
+	*r = t;
+	return co;
+}
+template<> inline uint32_t mpn<uint32_t>::subc(uint32_t a, uint32_t b, uint32_t c, uint32_t *r)
+{
+	unsigned int t;
+	uint32_t co = _subborrow_u32((unsigned char)c, a, b, &t);
+	*r = t;
+	return co;
+}
+#endif
+
+#if defined (MPN_ADDCARRY_U64)
+template<> inline uint64_t mpn<uint64_t>::addc(uint64_t a, uint64_t b, uint64_t c, uint64_t *r)
+{
+	unsigned long long t;
+	uint64_t co = _addcarry_u64((unsigned char)c, a, b, &t);
+	*r = t;
+	return co;
+}
+template<> inline uint64_t mpn<uint64_t>::subc(uint64_t a, uint64_t b, uint64_t c, uint64_t *r)
+{
+	unsigned long long t;
+	uint64_t co = _subborrow_u64((unsigned char)c, a, b, &t);
+	*r = t;
+	return co;
+}
+#endif
+
+#if !defined (__SIZEOF_INT128__)
+template<> inline uint64_t mpn<uint64_t>::umul(uint64_t a, uint64_t b, uint64_t *hi)
+{
+#if defined (_MSC_VER) && defined (_M_X64)
+	unsigned __int64 h;
+	uint64_t lo = _umul128(a, b, &h);
+	*hi = h;
+	return lo;
+#else
+	uint64_t al = uint32_t(a), ah = a >> 32, bl = uint32_t(b), bh = b >> 32;
+	uint64_t ll = al * bl, lh = al * bh, hl = ah * bl, hh = ah * bh;
+	uint64_t mid = (ll >> 32) + uint32_t(lh) + uint32_t(hl);
+	*hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+	return (mid << 32) | uint32_t(ll);
+#endif
+}
+#endif
+
+#if !defined (__SIZEOF_INT128__)
+template<> inline uint64_t mpn<uint64_t>::invert_limb(uint64_t d)
+{
+	/* restoring division of (~d * B + B - 1) by d one bit at a time */
+	uint64_t q = 0, r = ~d;
+	for (int i = 63; i >= 0; i--) {
+		uint64_t top = r >> 63;
+		r = (r << 1) | 1;
+		q <<= 1;
+		if (top || r >= d) {
+			r -= d;
+			q |= 1;
+		}
+	}
+	return q;
+}
+#endif
+
+/*------------------.
+| mpn_ops.          |
+`------------------*/
+
+/*
+ * mpn_ops is a table of the primitives for large spans, selected once
+ * at runtime. 64-bit limbs on x86-64 use mulx, adcx and adox kernels
+ * when CPUID reports BMI2 and ADX, otherwise the portable versions.
+ */
+
+template <typename L>
+struct mpn_ops
+{
+	L (*add_n)(L *r, const L *a, const L *b, size_t n);
+	L (*sub_n)(L *r, const L *a, const L *b, size_t n);
+	L (*mul_1)(L *r, const L *a, size_t n, L b);
+	L (*addmul_1)(L *r, const L *a, size_t n, L b);
+	L (*submul_1)(L *r, const L *a, size_t n, L b);
+	L (*lshift)(L *r, const L *a, size_t n, unsigned shamt);
+	L (*rshift)(L *r, const L *a, size_t n, unsigned shamt);
+	const char *name;
+
+	/*! return the dispatch table for this host */
+	static const mpn_ops& get();
+};
+
+template<> const mpn_ops<uint32_t>& mpn_ops<uint32_t>::get();
+template<> const mpn_ops<uint64_t>& mpn_ops<uint64_t>::get();
@@ -7,11 +7,13 @@
 #include <cstring>
 #include <array>
 #include <string>
+#include <ostream>
 #include <algorithm>
 #include <initializer_list>
 
 #include "bits.h"
 #include "hostint.h"
+#include "mpn.h"
 
 /*------------------.
 | wideint.          |
@@ -83,6 +85,9 @@ struct wideint
     /*! signed copy constructor */
     inline wideint(const wideint<bits,true,limb_bits> &o) : limbs(o.limbs) {};
 
+    /*! copy assignment */
+    inline wideint& operator=(const wideint &o) = default;
+
     /*! different size copy constructor */
     template <size_t o_bits, bool o_signed, size_t o_limb_bits>
     inline wideint(const wideint<o_bits,o_signed,o_limb_bits> &o)
@@ -189,26 +194,16 @@ struct wideint
     /*! add with carry equals */
     wideint& op_add(const wideint &operand)
     {
-        ulimb_t carry = 0;
-        for (size_t i = 0; i < lc; i++) {
-            ulimb_t old_val = limbs[i];
-            ulimb_t new_val = old_val + operand.limbs[i] + carry;
-            limbs[i] = new_val & limb_mask(i);
-            carry = new_val < old_val;
-        }
+        mpn<ulimb_t>::add_n(limbs.data(), limbs.data(), operand.limbs.data(), lc);
+        limbs[lc-1] &= limb_mask(lc-1);
         return *this;
     }
 
     /*! subtract with borrow equals */
     wideint& op_sub(const wideint &operand)
     {
-        ulimb_t borrow = 0;
-        for (size_t i = 0; i < lc; i++) {
-            ulimb_t old_val = limbs[i];
-            ulimb_t new_val = old_val - operand.limbs[i] - borrow;
-            limbs[i] = new_val & limb_mask(i);
-            borrow = new_val > old_val;
-        }
+        mpn<ulimb_t>::sub_n(limbs.data(), limbs.data(), operand.limbs.data(), lc);
+        limbs[lc-1] &= limb_mask(lc-1);
         return *this;
     }
 
@@ -224,14 +219,7 @@ struct wideint
                 limbs[i] = limbs[i-ls];
             }
         } else {
-            ptrdiff_t i = lc-1;
-            ulimb_t n = limbs[i-ls];
-            for (; i > ls; i--) {
-                ulimb_t m = limbs[i-ls-1];
-                limbs[i] = (n << shamt | m >> (-shamt & lsm));
-                n = m;
-            }
-            limbs[i] = (n << shamt);
+            mpn<ulimb_t>::lshift(limbs.data() + ls, limbs.data(), lc - ls, shamt);
         }
         for (ptrdiff_t i = ls-1; i >= 0; i--) {
             limbs[i] = 0;
@@ -253,16 +241,9 @@ struct wideint
                 limbs[i] = limbs[i+ls];
             }
         } else {
-            size_t i = 0;
-            ulimb_t n = limbs[i+ls];
-            for (; i < lc-ls-1; i++) {
-                ulimb_t m = limbs[i+ls+1];
-                limbs[i] = (n >> shamt | m << (-shamt & lsm));
-                n = m;
-            }
-            /* arithmetic shift if signed and this word is the last word */
-            ulimb_t lw = s && (i == lc-1) ? slimb_t(n) >> shamt : n >> shamt;
-            limbs[i] = lw | -s << ((nb-shamt-1) & lsm);
+            mpn<ulimb_t>::rshift(limbs.data(), limbs.data() + ls, lc - ls, shamt);
+            /* sign fill the vacated high bits of the last word */
+            limbs[lc-ls-1] |= -s << ((nb-shamt-1) & lsm);
         }
         for (size_t i = lc-ls; i < lc; i++) {
             limbs[i] = -s;
@@ -320,42 +301,29 @@ struct wideint
     /*! base 2^limb_bits multiply */
     static void op_mult(const wideint &multiplicand, const wideint multiplier, wideint &result)
     {
-        /* This routine is derived from Hacker's Delight,
-         * and possibly originates from Knuth */
-
-        const uhlimb_t *a = (uhlimb_t*)(void*)multiplier.limbs.data();
-        const uhlimb_t *b = (uhlimb_t*)(void*)multiplicand.limbs.data();
-        dhwideint tmp;
-
-        // skip zeros in the big end limbs
-        size_t m = hwideint::lc, n = hwideint::lc, k = dhwideint::lc;
-        for (;m > 1 && b[m-1] == 0; m--);
-        for (;n > 1 && a[n-1] == 0; n--);
-
-        uhlimb_t carry = 0;
-        udhlimb_t mj = a[0];
-        for (size_t i = 0; i < m && i < k; i++) {
-            udhlimb_t t = udhlimb_t(b[i]) * mj + carry;
-            tmp.limbs[i] = uhlimb_t(t);
-            carry = t >> limbh_bits;
-        }
-        if (m < k) {
-            tmp.limbs[m] = carry;
-        }
-        for (size_t j = 1; j < n; j++) {
-            carry = 0;
-            mj = a[j];
-            for (size_t i = 0; i < m && i + j < k; i++) {
-                udhlimb_t t = udhlimb_t(b[i]) * mj + udhlimb_t(tmp.limbs[i + j]) + carry;
-                tmp.limbs[i + j] = uhlimb_t(t);
-                carry = t >> limbh_bits;
-            }
-            if (j + m < k) {
-                tmp.limbs[j + m] = carry;
+        /*
+         * Truncated schoolbook multiply on full limbs. Loop bounds depend
+         * only on limb_count so small widths unroll completely. Products
+         * landing at or above limb lc are never formed and the top column
+         * only needs the low half of each product.
+         */
+        const ulimb_t *a = multiplicand.limbs.data(), *b = multiplier.limbs.data();
+        std::array<ulimb_t,lc> r{};
+
+        for (size_t j = 0; j < lc; j++) {
+            if (b[j] == 0) continue;
+            ulimb_t c = 0;
+            for (size_t i = 0; i + j < lc - 1; i++) {
+                ulimb_t hi, lo = mpn<ulimb_t>::umul(a[i], b[j], &hi);
+                lo += c;
+                hi += lo < c;
+                r[i + j] += lo;
+                c = hi + (r[i + j] < lo);
             }
+            r[lc - 1] += ulimb_t(a[lc - 1 - j] * b[j] + c);
         }
-
-        result = tmp;
+        r[lc - 1] &= result.limb_mask(lc - 1);
+        result.limbs = r;
     }
 
     /*! base 2^limb_bits division */
@@ -365,42 +333,37 @@ struct wideint
         /* This routine is derived from Hacker's Delight,
          * and possibly originates from Knuth */
 
-        dhwideint quotient = 0;
-        dhwideint remainder = 0;
+        const ulimb_t *u = dividend.limbs.data(), *v = divisor.limbs.data();
 
-        /*
-         * Note: we access the operand limbs as 32-bit words because there
-         * is no standard 128-bit result op :uint64 * :uint64 -> :uint128
-         * Also, the results for the wide
-         */
-        uhlimb_t *q = quotient.limbs.data(), *r = remainder.limbs.data();
-        const uhlimb_t *u = (uhlimb_t*)(void*)dividend.limbs.data();
-        const uhlimb_t *v = (uhlimb_t*)(void*)divisor.limbs.data();
+        /* single limb widths use the hardware divide */
+        if (lc == 1) {
+            if (v[0] == 0) {
+                res_quotient = 0;
+                res_remainder = dividend;
+            } else {
+                res_quotient = wideint(ulimb_t(u[0] / v[0]));
+                res_remainder = wideint(ulimb_t(u[0] % v[0]));
+            }
+            return;
+        }
 
         // skip zeros in the big end limbs
-        ptrdiff_t m = hwideint::lc, n = hwideint::lc;
+        size_t m = lc, n = lc;
         for (;m > 1 && u[m-1] == 0; m--);
         for (;n > 1 && v[n-1] == 0; n--);
 
-        const udhlimb_t b = (1ULL << limbh_bits); // Number base
-        uhlimb_t *un, *vn;                        // Normalized form of u, v.
-        udhlimb_t qhat;                           // Estimated quotient digit.
-        udhlimb_t rhat;                           // A remainder.
-
-        if (m < n || n <= 0 || v[n-1] == 0) {
+        if (m < n || v[n-1] == 0) {
             res_quotient = 0;
             res_remainder = dividend;
             return;
         }
 
-        // Single digit divisor
+        wideint quotient, remainder;
+        ulimb_t *q = quotient.limbs.data(), *r = remainder.limbs.data();
+
+        /* single limb divisors chain 2-by-1 steps sharing one reciprocal */
         if (n == 1) {
-            udhlimb_t k = 0;
-            for (ptrdiff_t j = m - 1; j >= 0; j--) {
-                q[j] = uhlimb_t((k*b + u[j]) / v[0]);
-                k = (k*b + u[j]) - q[j]*v[0];
-            }
-            r[0] = uhlimb_t(k);
+            r[0] = mpn<ulimb_t>::divrem_1(q, u, m, v[0]);
             res_quotient = quotient;
             res_remainder = remainder;
             return;
@@ -411,57 +374,55 @@ struct wideint
         // same amount. We may have to append a high-order
         // digit on the dividend; we do that unconditionally.
 
-        int s = clz(v[n-1]); // 0 <= s <= limb_bits.
-        vn = (uhlimb_t *)alloca(sizeof(uhlimb_t) * n);
-        for (ptrdiff_t i = n - 1; i > 0; i--) {
-            vn[i] = (v[i] << s) | (v[i-1] >> (limbh_bits-s));
-        }
-        vn[0] = v[0] << s;
-
-        un = (uhlimb_t *)alloca(sizeof(uhlimb_t) * (m + 1));
-        un[m] = u[m-1] >> (limbh_bits-s);
-        for (ptrdiff_t i = m - 1; i > 0; i--) {
-            un[i] = (u[i] << s) | (u[i-1] >> (limbh_bits-s));
-        }
-        un[0] = u[0] << s;
-        for (ptrdiff_t j = m - n; j >= 0; j--) { // Main loop.
-            // Compute estimate qhat of q[j].
-            qhat = (un[j+n]*b + un[j+n-1]) / vn[n-1];
-            rhat = (un[j+n]*b + un[j+n-1]) - qhat * vn[n-1];
-        again:
-            if (qhat >= b || qhat*vn[n-2] > b*rhat + un[j+n-2]) {
+        std::array<ulimb_t,lc> vn;
+        std::array<ulimb_t,lc+1> un;
+        int s = clz(v[n-1]); // 0 <= s < limb_bits.
+        if (s > 0) {
+            mpn<ulimb_t>::lshift(vn.data(), v, n, s);
+            un[m] = mpn<ulimb_t>::lshift(un.data(), u, m, s);
+        } else {
+            std::copy(v, v + n, vn.begin());
+            std::copy(u, u + m, un.begin());
+            un[m] = 0;
+        }
+
+        const ulimb_t d1 = vn[n-1], d0 = vn[n-2], dinv = mpn<ulimb_t>::invert_limb(d1);
+        for (size_t j = m - n + 1; j-- > 0; ) { // Main loop.
+            // Compute estimate qhat of q[j] using the reciprocal of d1,
+            // rover records a carry out of rhat which ends correction.
+            ulimb_t n1 = un[j+n], n0 = un[j+n-1], qhat, rhat;
+            bool rover = false;
+            if (n1 == d1) {
+                qhat = ~ulimb_t(0);
+                rhat = n0 + d1;
+                rover = rhat < d1;
+            } else {
+                qhat = mpn<ulimb_t>::div_preinv(n1, n0, d1, dinv, &rhat);
+            }
+            while (!rover) {
+                ulimb_t ph, pl = mpn<ulimb_t>::umul(qhat, d0, &ph);
+                if (ph < rhat || (ph == rhat && pl <= un[j+n-2])) break;
                 qhat = qhat - 1;
-                rhat = rhat + vn[n-1];
-                if (rhat < b) goto again;
+                rhat = rhat + d1;
+                rover = rhat < d1;
             }
             // Multiply and subtract.
-            udhlimb_t k = 0;
-            sdhlimb_t t = 0;
-            for (ptrdiff_t i = 0; i < n; i++) {
-                unsigned long long p = qhat*vn[i];
-                t = un[i+j] - k - (p & ((1ULL<<limbh_bits)-1));
-                un[i+j] = uhlimb_t(t);
-                k = (p >> limbh_bits) - (t >> limbh_bits);
-            }
-            t = un[j+n] - k;
-            un[j+n] = uhlimb_t(t);
+            ulimb_t borrow = mpn<ulimb_t>::submul_1(un.data() + j, vn.data(), n, qhat);
+            ulimb_t top = un[j+n];
+            un[j+n] = top - borrow;
 
-            q[j] = uhlimb_t(qhat); // Store quotient digit.
-            if (t < 0) {          // If we subtracted too
+            q[j] = qhat;          // Store quotient digit.
+            if (top < borrow) {   // If we subtracted too
                 q[j] = q[j] - 1;  // much, add back.
-                k = 0;
-                for (ptrdiff_t i = 0; i < n; i++) {
-                    t = un[i+j] + vn[i] + k;
-                    un[i+j] = uhlimb_t(t);
-                    k = t >> limbh_bits;
-                }
-                un[j+n] = uhlimb_t(un[j+n] + k);
+                un[j+n] += mpn<ulimb_t>::add_n(un.data() + j, un.data() + j, vn.data(), n);
             }
         }
 
         // normalize remainder
-        for (ptrdiff_t i = 0; i < n; i++) {
-            r[i] = (un[i] >> s) | (un[i + 1] << (limbh_bits - s));
+        if (s > 0) {
+            mpn<ulimb_t>::rshift(r, un.data(), n, s);
+        } else {
+            std::copy(un.begin(), un.begin() + n, r);
         }
 
         res_quotient = quotient;
@@ -632,76 +593,115 @@ struct wideint
     | string conversion. |
     `-------------------*/
 
-    /*! convert from wideint to string */
-    std::string to_string(size_t radix = 10) const
+    /*! characters bounding every radix, a prefix and one digit per bit */
+    enum { max_chars = nb + 2 };
+
+    /*! format right aligned into buf[0..max_chars), returns offset of first character */
+    size_t format_chars(char *buf, size_t radix) const
     {
         static const char* hexdigits = "0123456789abcdef";
 
+        size_t o = max_chars;
         switch (radix) {
             case 10: {
-                if (*this == 0) return "0";
-
-                std::string s;
-                wideint v = *this, t = 10, q, r;
+                /* peel 19 digit chunks (9 with 32-bit limbs) by single limb division */
+                const size_t cd = lb == 64 ? 19 : 9;
+                const ulimb_t base = ulimb_t(lb == 64 ? 10000000000000000000ull : 1000000000ull);
+                const int s = clz(base);
+                const ulimb_t dn = ulimb_t(base << s), dv = mpn<ulimb_t>::invert_limb(dn);
+                std::array<ulimb_t,lc> u = limbs;
+                size_t n = lc;
+                while (n > 0 && u[n - 1] == 0) n--;
                 do {
-                    op_divrem(v, t, q, r);
-                    s.push_back('0' + char(r.limbs[0]));
-                    v = q;
-                } while (v != 0);
-
-                return std::string(s.rbegin(), s.rend());;
-            }
-            case 2: {
-                if (*this == 0) return "0b0";
-
-                std::string s("0b");
-                ulimb_t l1 = limbs.back();
-                size_t n = limb_bits - clz(l1);
-                size_t t = n + ((wideint::limb_count - 1) << wideint::limb_shift);
-                s.resize(t + 2);
-                auto i = s.begin() + 2;
-                for (ptrdiff_t k = n - 1; k >= 0; k--) {
-                    *(i++) = '0' + ((l1 >> k) & 1);
-                }
-                for (ptrdiff_t j = wideint::limb_count - 2; j >= 0; j--) {
-                    ulimb_t l = limbs[j];
-                    for (ptrdiff_t k = limb_bits - 1; k >= 0; k--) {
-                        *(i++) = '0' + ((l >> k) & 1);
-                    }
-                }
-                return s;
+                    ulimb_t r = n > 0 ? mpn<ulimb_t>::divrem_1_preinv(u.data(), u.data(), n, dn, s, dv) : 0;
+                    while (n > 0 && u[n - 1] == 0) n--;
+                    o = size_t(mpn<ulimb_t>::put_dec(buf + o, r, n > 0 ? cd : 0) - buf);
+                } while (n > 0);
+                return o;
             }
+            case 2:
             case 16: {
-                if (*this == 0) return "0x0";
-
-                std::string s("0x");
-                ulimb_t l1 = limbs.back();
-                size_t n = ((limb_bits >> 2) - (clz(l1) >> 2));
-                size_t t = n + ((wideint::limb_count - 1) << (wideint::limb_shift - 2));
-                s.resize(t + 2);
-                auto i = s.begin() + 2;
-                for (ptrdiff_t k = n - 1; k >= 0; k--) {
-                    *(i++) = hexdigits[(l1 >> (k << 2)) & 0xf];
-                }
-                for (ptrdiff_t j = wideint::limb_count - 2; j >= 0; j--) {
-                    ulimb_t l = limbs[j];
-                    for (ptrdiff_t k = (limb_bits >> 2) - 1; k >= 0; k--) {
-                        *(i++) = hexdigits[(l >> (k << 2)) & 0xf];
+                unsigned shift = radix == 16 ? 4 : 1;
+                if (*this == 0) {
+                    buf[--o] = '0';
+                } else {
+                    /* limbs below the top one are printed in full */
+                    for (size_t j = 0; j < lc - 1; j++) {
+                        ulimb_t l = limbs[j];
+                        for (size_t k = 0; k < limb_bits; k += shift, l >>= shift) {
+                            buf[--o] = hexdigits[l & (radix - 1)];
+                        }
+                    }
+                    ulimb_t l1 = limbs[lc - 1];
+                    for (; l1 != 0; l1 >>= shift) {
+                        buf[--o] = hexdigits[l1 & (radix - 1)];
                     }
                 }
-                return s;
+                buf[--o] = radix == 16 ? 'x' : 'b';
+                buf[--o] = '0';
+                return o;
             }
             default: {
-                return std::string();
+                return o;
             }
         }
     }
 
+    /*! return the exact number of characters to_string produces */
+    size_t to_chars_size(size_t radix = 10) const
+    {
+        char buf[max_chars];
+        return max_chars - format_chars(buf, radix);
+    }
+
+    /*! write to_string characters to [first, last), returns the end or nullptr if they do not fit */
+    char* to_chars(char *first, char *last, size_t radix = 10) const
+    {
+        char buf[max_chars];
+        size_t o = format_chars(buf, radix), n = max_chars - o;
+        if (n == 0 || size_t(last - first) < n) return nullptr;
+        std::memcpy(first, buf + o, n);
+        return first + n;
+    }
+
+    /*! convert from wideint to string */
+    std::string to_string(size_t radix = 10) const
+    {
+        char buf[max_chars];
+        size_t o = format_chars(buf, radix);
+        return std::string(buf + o, buf + max_chars);
+    }
+
+    /*! parse a run of digits from [first, last), returns the end or nullptr if there are none */
+    const char* from_chars(const char *first, const char *last, size_t radix = 0)
+    {
+        if (last - first > 2 && first[0] == '0') {
+            if (first[1] == 'b' && (radix == 0 || radix == 2)) {
+                radix = 2;
+                first += 2;
+            } else if (first[1] == 'x' && (radix == 0 || radix == 16)) {
+                radix = 16;
+                first += 2;
+            }
+        }
+        if (radix == 0) {
+            radix = 10;
+        }
+        if (radix != 2 && radix != 10 && radix != 16) return nullptr;
+        const char *end = mpn<ulimb_t>::scan_digits(first, last, radix);
+        if (end == first) return nullptr;
+
+        /* leading zeros keep from_string from reading 0b as a prefix */
+        while (end - first > 1 && *first == '0') first++;
+        *this = 0;
+        from_string(first, end - first, radix);
+        return end;
+    }
+
     /*! convert to wideint from string */
     void from_string(const char *str, size_t len, size_t radix)
     {
         static const wideint tenp18{0xde0b6b3a7640000ull};
-        static const wideint twop64{0,1};
         if (len > 2) {
             if (strncmp(str, "0b", 2) == 0) {
                 radix = 2;
@@ -720,8 +720,14 @@ struct wideint
             case 10: {
                 for (size_t i = 0; i < len; i += 18) {
                     size_t chunklen = i + 18 < len ? 18 : len - i;
-                    std::string chunk(str + i, chunklen);
-                    udhlimb_t num = strtoull(chunk.c_str(), nullptr, 10);
+                    udhlimb_t num = 0;
+                    size_t j = i;
+                    for (; j + 8 <= i + chunklen; j += 8) {
+                        num = num * 100000000 + mpn<ulimb_t>::unpack_dec_8(mpn<ulimb_t>::load_8(str + j));
+                    }
+                    for (; j < i + chunklen; j++) {
+                        num = num * 10 + udhlimb_t(str[j] - '0');
+                    }
                     if (chunklen == 18) {
                         *this *= tenp18;
                     } else {
@@ -731,32 +737,14 @@ struct wideint
                 }
                 break;
             }
-            case 2: {
-                for (size_t i = 0; i < len; i += 64) {
-                    size_t chunklen = i + 64 < len ? 64 : len - i;
-                    std::string chunk(str + i, chunklen);
-                    udhlimb_t num = strtoull(chunk.c_str(), nullptr, 2);
-                    if (chunklen == 64) {
-                        *this *= twop64;
-                    } else {
-                        *this *= wideint(2).pow(chunklen);
-                    }
-                    *this += wideint{ulimb_t(num)};
-                }
-                break;
-            }
+            case 2:
             case 16: {
-                for (size_t i = 0; i < len; i += 16) {
-                    size_t chunklen = i + 16 < len ? 16 : len - i;
-                    std::string chunk(str + i, chunklen);
-                    udhlimb_t num = strtoull(chunk.c_str(), nullptr, 16);
-                    if (chunklen == 16) {
-                        *this *= twop64;
-                    } else {
-                        *this *= wideint(16).pow(chunklen);
-                    }
-                    *this += wideint{ulimb_t(num)};
-                }
+                /* pack the digits directly into limbs */
+                unsigned shift = radix == 16 ? 4 : 1;
+                wideint val;
+                mpn<ulimb_t>::set_str_2exp(val.limbs.data(), lc, str, len, shift);
+                val.limbs[lc-1] &= limb_mask(lc-1);
+                limbs = (len * shift < nb ? (*this << int(len * shift)) | val : val).limbs;
                 break;
             }
             default: {
@@ -776,4 +764,11 @@ template <size_t bits, bool is_signed = true, size_t limb_bits_param = 64 >
 inline int ctz(const wideint<bits,is_signed,limb_bits_param> &val) { return val.count_trailing_zeros(); }
 
 template <size_t bits, bool is_signed = true, size_t limb_bits_param = 64 >
-inline int ctz(wideint<bits,is_signed,limb_bits_param> &&val) { return val.count_trailing_zeros(); }
\ No newline at end of file
+inline int ctz(wideint<bits,is_signed,limb_bits_param> &&val) { return val.count_trailing_zeros(); }
+
+template <size_t bits, bool is_signed = true, size_t limb_bits_param = 64 >
+inline std::ostream& operator<<(std::ostream &os, const wideint<bits,is_signed,limb_bits_param> &val)
+{
+    std::string s = val.to_string();
+    return os.write(s.data(), s.size());
+}
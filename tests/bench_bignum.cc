@@ -2,6 +2,8 @@
 
 #include <cstdio>
 #include <chrono>
+#include <random>
+#include <vector>
 
 #include <bignum.h>
 #include <gmp.h>
@@ -44,6 +46,52 @@ void test_gmp(int a, int b)
 	mpz_clear(result);
 }
 
+void test_divisor(size_t n, int iters)
+{
+	typedef bignum::ulimb_t ulimb_t;
+	std::mt19937_64 rng(n);
+	auto rand_limbs = [&](size_t k) {
+		bignum x(0);
+		for (size_t i = 0; i < k; i++) {
+			ulimb_t top = i == 0 ? ulimb_t(1) << (bignum::limb_bits - 1) : 0;
+			x = (x << bignum::limb_bits) + bignum(ulimb_t(rng()) | top);
+		}
+		return x;
+	};
+
+	bignum d = rand_limbs(n);
+	std::vector<bignum> u;
+	for (int i = 0; i < 64; i++) u.push_back(rand_limbs(2 * n - 1));
+
+	bignum_divisor dv(d);
+	bignum_barrett bb(d);
+	bignum q(0), r(0), sum(0);
+
+	auto t1 = std::chrono::system_clock::now();
+	for (int i = 0; i < iters; i++) {
+		bignum::divrem(u[i & 63], d, q, r);
+		sum += r;
+	}
+	auto t2 = std::chrono::system_clock::now();
+	for (int i = 0; i < iters; i++) {
+		dv.divrem(u[i & 63], q, r);
+		sum += r;
+	}
+	auto t3 = std::chrono::system_clock::now();
+	for (int i = 0; i < iters; i++) {
+		bb.divrem(u[i & 63], q, r);
+		sum += r;
+	}
+	auto t4 = std::chrono::system_clock::now();
+
+	double td = std::chrono::duration_cast<std::chrono::nanoseconds>(t2-t1).count() / double(iters);
+	double tv = std::chrono::duration_cast<std::chrono::nanoseconds>(t3-t2).count() / double(iters);
+	double tb = std::chrono::duration_cast<std::chrono::nanoseconds>(t4-t3).count() / double(iters);
+
+	printf("div: limbs=%5zu divrem=%10.1f(ns) divisor=%10.1f(ns) barrett=%10.1f(ns) bits=%zu\n",
+		n, td, tv, tb, sum.num_bits());
+}
+
 int main(int argc, char const *argv[])
 {
 	test_bit(71, 717);
@@ -52,4 +100,12 @@ int main(int argc, char const *argv[])
 	test_gmp(71, 7117);
 	test_bit(71, 71117);
 	test_gmp(71, 71117);
+	test_divisor(2, 1000000);
+	test_divisor(4, 1000000);
+	test_divisor(8, 500000);
+	test_divisor(16, 200000);
+	test_divisor(30, 100000);
+	test_divisor(60, 20000);
+	test_divisor(250, 2000);
+	test_divisor(1000, 200);
 }
@@ -1,8 +1,11 @@
 // See LICENSE.md
 
 #include <cassert>
+#include <cstdio>
+#include <sstream>
 
 #include "bignum.h"
+#include "mpn.h"
 
 void test_bignum()
 {
@@ -124,28 +127,75 @@ void test_bignum()
 	bignum b9{0,std::numeric_limits<bignum::ulimb_t>::max()};
 	bignum b10{0,std::numeric_limits<bignum::ulimb_t>::max()-1,1};
 	assert(b9 + b9 == b10);
+	assert(bignum(1) + ((bignum(1) << 64) - 1) == bignum(1) << 64);
+	assert((bignum(1) << 64) - bignum(1) == bignum("0xffffffffffffffff"));
 
 	/* test multiplication */
 	bignum b12 = bignum(2147483648) * bignum(2147483648);
+	bignum b13 = b12 * b12;
+	bignum b14 = bignum(2147483647) * bignum(2147483647);
+	bignum b15 = b14 * b14;
+#if BIGNUM_LIMB_BITS == 32
 	assert(b12.num_limbs() == 2);
 	assert(b12.limb_at(0) == 0);
 	assert(b12.limb_at(1) == 1073741824);
-	bignum b13 = b12 * b12;
 	assert(b13.num_limbs() == 4);
 	assert(b13.limb_at(0) == 0);
 	assert(b13.limb_at(1) == 0);
 	assert(b13.limb_at(2) == 0);
 	assert(b13.limb_at(3) == 268435456);
-	bignum b14 = bignum(2147483647) * bignum(2147483647);
 	assert(b14.num_limbs() == 2);
 	assert(b14.limb_at(0) == 1);
 	assert(b14.limb_at(1) == 1073741823);
-	bignum b15 = b14 * b14;
 	assert(b15.num_limbs() == 4);
 	assert(b15.limb_at(0) == 1);
 	assert(b15.limb_at(1) == 2147483646);
 	assert(b15.limb_at(2) == 2147483649);
 	assert(b15.limb_at(3) == 268435455);
+#endif
+	assert(b12 == bignum(1) << 62 && b13 == bignum(1) << 124);
+	assert(b14 == bignum("0x3fffffff00000001") && b15 == bignum("0xfffffff800000017ffffffe00000001"));
+
+	/* test karatsuba multiplication */
+	bignum b21 = (bignum(1) << 4000) - 1;
+	bignum b22 = (bignum(1) << 10000) - 1;
+	assert(b21 * b21 == (bignum(1) << 8000) - (bignum(1) << 4001) + 1);
+	assert(b21 * b22 == (bignum(1) << 14000) - (bignum(1) << 10000) - (bignum(1) << 4000) + 1);
+	assert(b22 * b21 == b21 * b22);
+	bignum b23(0, is_unsigned(), 4096);
+	b23 = b21;
+	assert(b23 * b23 == (bignum(1) << 4096) - (bignum(1) << 4001) + 1);
+
+	/* test toom-cook multiplication */
+	bignum b24 = (bignum(1) << 6000) - 3;
+	bignum b25 = (bignum(1) << 40000) - 5;
+	assert(b24 * b24 == (bignum(1) << 12000) - (bignum(6) << 6000) + 9);
+	assert(b25 * b25 == (bignum(1) << 80000) - (bignum(10) << 40000) + 25);
+	assert(b24 * b25 == (bignum(1) << 46000) - (bignum(3) << 40000) - (bignum(5) << 6000) + 15);
+
+	/* test number theoretic transform multiplication */
+	bignum b26 = (bignum(1) << 100000) - 7;
+	bignum b27 = (bignum(1) << 300000) - 1;
+	assert(b26 * b26 == (bignum(1) << 200000) - (bignum(14) << 100000) + 49);
+	assert(b26 * b27 == (bignum(1) << 400000) - (bignum(1) << 100000) - (bignum(7) << 300000) + 7);
+
+	/* test squaring */
+	bignum b28;
+	bignum::sqr(b21, b28);
+	assert(b28 == b21 * bignum(b21));
+	bignum::sqr(b25, b28);
+	assert(b28 == b25 * bignum(b25));
+	bignum b29 = b26;
+	b29 *= b29;
+	assert(b29 == (bignum(1) << 200000) - (bignum(14) << 100000) + 49);
+	bignum b30 = bignum{0xffffffff, 0xffffffff, 0xffffffff};
+	bignum::sqr(b30, b30);
+#if BIGNUM_LIMB_BITS == 32
+	assert(b30 == (bignum{0x00000001, 0, 0, 0xfffffffe, 0xffffffff, 0xffffffff}));
+#endif
+	bignum b11 = (bignum(1) << 96) - 1;
+	bignum::sqr(b11, b11);
+	assert(b11 == bignum("0xfffffffffffffffffffffffe000000000000000000000001"));
 
 	/* test subtraction */
 	assert((bignum{3,3,3} - bignum{1,1,1} == bignum{2,2,2}));
@@ -157,10 +207,44 @@ void test_bignum()
 
 	/* test division */
 	bignum b19 = b15 / b14;
+#if BIGNUM_LIMB_BITS == 32
 	assert(b19.num_limbs() == 2);
 	assert(b19.limb_at(0) == 1);
 	assert(b19.limb_at(1) == 1073741823);
+#endif
+	assert(b19 == b14);
 	assert(b19.to_string() == "4611686014132420609");
+	assert(((bignum(1) << 128) - 1) / ((bignum(1) << 64) - 1) == (bignum(1) << 64) + 1);
+	assert(bignum("0xffffffffffffffff4b306bc30b72a6b9ffffffff") %
+		bignum("0xffffffffffffffffb152a12b3447500ab78c907") ==
+		bignum("0xfffffffffffffff94f2f4aa8a6fcbaff3ec3896"));
+
+	/* test divide and conquer division */
+	bignum b31 = b27 * b24 + b25, b32, b33;
+	bignum::divrem(b31, b27, b32, b33);
+	assert(b32 == b24 && b33 == b25);
+	bignum::divrem(b27, b26 + b22, b32, b33);
+	assert(b32 * (b26 + b22) + b33 == b27 && b33 < b26 + b22);
+
+	/* test divisor contexts */
+	bignum_divisor dv1(b24), dv2(bignum(10) << 40);
+	dv1.divrem(b31, b32, b33);
+	assert(b32 * b24 + b33 == b31 && b33 < b24);
+	assert(dv1.mod(b24 * b25 + 5) == 5);
+	assert(dv1.divexact(b24 * b25) == b25);
+	assert(dv2.divexact(b25 * (bignum(10) << 40)) == b25);
+	assert(dv2.mod(bignum("12345678901234567890123")) == bignum("508706309323"));
+	bignum b34{0, 0, 0x80000000};
+	bignum_barrett bb1(b24), bb2(b34);
+	assert(bb1.mod(b24 * b24 - 1) == b24 - 1);
+	bb2.divrem(b30, b32, b33);
+	assert(b32 * b34 + b33 == b30 && b33 < b34);
+	bignum b35 = b34 * b34 - 1, b36 = b35;
+	bb2.divrem(b36, b36, b33);
+	assert(b36 == b34 - 1 && b33 == b34 - 1);
+	b36 = b35;
+	dv1.divrem(b36, b32, b36);
+	assert(b32 * b24 + b36 == b35 && b36 < b24);
 
 	/* test set and test bit */
 	bignum b20;
@@ -180,21 +264,24 @@ void test_bignum()
 	/* binary string formatting */
 	assert((bignum{0b101}).to_string(2) == "0b101");
 	assert((bignum{0b111100001111}).to_string(2) == "0b111100001111");
-	assert((bignum{0xff00ff,0xff}).to_string(2) == "0b1111111100000000111111110000000011111111");
+	assert(((bignum(0xff) << 32) | bignum(0xff00ff)).to_string(2) == "0b1111111100000000111111110000000011111111");
 
 	/* hex string formatting */
 	assert((bignum{0x1}).to_string(16) == "0x1");
 	assert((bignum{0x7f}).to_string(16) == "0x7f");
 	assert((bignum{0x3ff}).to_string(16) == "0x3ff");
-	assert((bignum{0xffffffff,1}).to_string(16) == "0x1ffffffff");
-	assert((bignum{0xffffffff,0x80}).to_string(16) == "0x80ffffffff");
-	assert((bignum{0xffffffff,0x400}).to_string(16) == "0x400ffffffff");
-	assert((bignum{0x80000000,0x80000000}).to_string(16) == "0x8000000080000000");
+	assert(((bignum(1) << 32) | bignum(0xffffffff)).to_string(16) == "0x1ffffffff");
+	assert(((bignum(0x80) << 32) | bignum(0xffffffff)).to_string(16) == "0x80ffffffff");
+	assert(((bignum(0x400) << 32) | bignum(0xffffffff)).to_string(16) == "0x400ffffffff");
+	assert(((bignum(0x80000000) << 32) | bignum(0x80000000)).to_string(16) == "0x8000000080000000");
 
 	/* pow */
 	assert(bignum(71).pow(0) == 1);
 	assert(bignum(71).pow(1) == 71);
 	assert(bignum(71).pow(17).to_string() == "29606831241262271996845213307591");
+	assert(bignum(10).pow(18).to_string() == "1" + std::string(18, '0'));
+	assert(bignum(10).pow(2500).to_string() == "1" + std::string(2500, '0'));
+	assert(bignum(((bignum(1) << 15314) - 1).to_string()) == (bignum(1) << 15314) - 1);
 
 	/* from string */
 	assert(bignum("71").to_string() == "71");
@@ -205,28 +292,100 @@ void test_bignum()
 	assert(bignum("0b11110000111100001111000011110000").to_string(2) == "0b11110000111100001111000011110000");
 	assert(bignum("3249094308290873429032409832424398902348094329803249083249089802349809430822903").to_string()
 		== "3249094308290873429032409832424398902348094329803249083249089802349809430822903");
+	assert(bignum(b24.to_string()) == b24);
+	assert(bignum(b26.to_string()) == b26);
+	assert(bignum(std::string(2500, '9')) == bignum(10).pow(2500) - 1);
+	assert(bignum(b26.to_string(16)) == b26);
+	assert(bignum(b26.to_string(2)) == b26);
+	assert(bignum("0xDEADBEEF00ff00ff00FF00FF").to_string(16) == "0xdeadbeef00ff00ff00ff00ff");
+	assert(bignum("0x1" + std::string(20, '0'), is_unsigned(), 64) == 0);
+	assert(bignum(b26.to_string(), is_unsigned(), 64) == bignum("0xfffffffffffffff9", is_unsigned(), 64));
+
+	/* threaded radix 10 conversion */
+	{
+		bignum b40 = bignum(7).pow(100000);
+		std::string s40 = b40.to_string();
+		bignum::set_conversion_threads(4);
+		assert(bignum::conversion_threads() == 4);
+		assert(b40.to_string() == s40);
+		assert(bignum(s40) == b40);
+		bignum::set_conversion_threads(1);
+	}
+
+	/* streaming output */
+	{
+		bignum b41 = bignum(7).pow(20000);
+		std::ostringstream os;
+		os << bignum(0) << ' ' << bignum(10).pow(18) << ' ' << b41;
+		assert(os.str() == "0 1" + std::string(18, '0') + ' ' + b41.to_string());
+		FILE *f = tmpfile();
+		assert(f);
+		bool ok = b41.write_to(f, 16) && b41.write_to(f, 2) && b41.write_to(f);
+		assert(ok);
+		std::string s41 = b41.to_string(16) + b41.to_string(2) + b41.to_string();
+		std::string r41(s41.size() + 1, ' ');
+		rewind(f);
+		r41.resize(fread(&r41[0], 1, r41.size(), f));
+		assert(r41 == s41);
+		fclose(f);
+	}
+
+	/* caller buffers */
+	{
+		bignum b42 = bignum(7).pow(3000);
+		for (size_t radix : {2, 10, 16}) {
+			std::string s42 = b42.to_string(radix);
+			std::vector<char> v42(s42.size());
+			char *buf = v42.data();
+			assert(b42.to_chars_size(radix) == s42.size());
+			assert(b42.to_chars(buf, buf + s42.size() - 1, radix) == nullptr);
+			char *end = b42.to_chars(buf, buf + s42.size(), radix);
+			assert(end == buf + s42.size() && std::string(buf, end) == s42);
+		}
+		for (size_t n = 1; n < 600; n += n < 60 ? 1 : 37) {
+			bignum p = bignum(10).pow(n);
+			assert(p.to_chars_size() == n + 1 && (p - 1).to_chars_size() == n);
+			assert((p + 1).to_chars_size() == n + 1 && (p * 9).to_chars_size() == n + 1);
+		}
+		assert(bignum(0).to_chars_size() == 1 && bignum(0).to_chars_size(16) == 3);
+
+		bignum b43;
+		const char *str = "0x00ff, 1234 0b12 0b";
+		assert(b43.from_chars(str, str + 20) == str + 6 && b43 == 255);
+		assert(b43.from_chars(str + 8, str + 20) == str + 12 && b43 == 1234);
+		assert(b43.from_chars(str + 13, str + 20) == str + 16 && b43 == 1);
+		assert(b43.from_chars(str + 13, str + 20, 16) == str + 17 && b43 == 0xb12);
+		assert(b43.from_chars(str + 4, str + 20) == nullptr && b43 == 0xb12);
+		std::string s42 = b42.to_string();
+		assert(b43.from_chars(s42.data(), s42.data() + s42.size()) == s42.data() + s42.size() && b43 == b42);
+		b43 = 7;
+		b43.from_string(s42.data(), s42.size(), 10);
+		assert(b43 == bignum("7" + s42));
+	}
 
 	/* fixed width tests */
 	assert(bignum(0xffffffff, is_unsigned(), 32) + 2 == 1);
 	assert(bignum(0xffffffff, is_unsigned(), 31) == 0x7fffffff);
 	assert(bignum(0x7fffffff, is_unsigned(), 31) + 2 == 1);
 	assert(bignum("0xffffffff", is_unsigned(), 31) == 0x7fffffff);
-	assert(bignum(100000) * bignum(100000) == (bignum{0x540be400, 0x2}));
-	assert(bignum(100000, is_unsigned(), 34) * bignum(100000, is_unsigned(), 34) == (bignum{0x540be400, 0x2}));
+	assert(bignum(100000) * bignum(100000) == bignum("0x2540be400"));
+	assert(bignum(100000, is_unsigned(), 34) * bignum(100000, is_unsigned(), 34) == bignum("0x2540be400"));
 	assert(bignum(100000, is_unsigned(), 33) * bignum(100000, is_unsigned(), 33) == bignum(0x540be400));
 	assert(bignum(100000, is_unsigned(), 32) * bignum(100000, is_unsigned(), 32) == bignum(0x540be400));
 	assert(bignum(100000, is_unsigned(), 20) * bignum(100000, is_unsigned(), 20) == bignum(0xbe400));
 	assert(-bignum(1, is_unsigned(), 32) == bignum(-1, is_unsigned(), 32));
-	assert(-bignum(1, is_unsigned(), 64) == bignum({0xffffffff, 0xffffffff}, is_unsigned(), 64));
-	assert(-bignum(1, is_unsigned(), 65) == bignum({0xffffffff, 0xffffffff,1}, is_unsigned(), 65));
-	assert(bignum({0xffffffff, 0x7fffffff,1}, is_unsigned(), 65) >> 1 == bignum({0xffffffff, 0xbfffffff}, is_unsigned(), 65));
-	assert(-bignum(1, is_signed(), 65) >> 1 == bignum({0xffffffff, 0xffffffff,1}, is_signed(), 65));
-	assert(bignum({0xffffffff, 0x7fffffff,1}, is_signed(), 65) >> 1 == bignum({0xffffffff, 0xbfffffff,1}, is_signed(), 65));
-	assert(bignum({0xffffffff, 0xffffffff}, is_signed(), 65) >> 1 == bignum({0xffffffff, 0x7fffffff}, is_signed(), 65));
-	assert(-bignum(1, is_unsigned(), 65) >> 1 == bignum({0xffffffff, 0xffffffff}, is_unsigned(), 65));
-	assert(-bignum(1, is_unsigned(), 65) >> 2 == bignum({0xffffffff, 0x7fffffff}, is_unsigned(), 65));
-	assert(-bignum(1, is_unsigned(), 65) << 1 == bignum({0xfffffffe, 0xffffffff,1}, is_unsigned(), 65));
-	assert(-bignum(1, is_unsigned(), 65) << 2 == bignum({0xfffffffc, 0xffffffff,1}, is_unsigned(), 65));
+	bignum u65 = (bignum(1, is_unsigned(), 65) << 64) - 1;
+	bignum s65("0xffffffffffffffff", is_signed(), 65);
+	assert(-bignum(1, is_unsigned(), 64) == bignum("0xffffffffffffffff", is_unsigned(), 64));
+	assert(-bignum(1, is_unsigned(), 65) == bignum("0x1ffffffffffffffff", is_unsigned(), 65));
+	assert(bignum("0x17fffffffffffffff", is_unsigned(), 65) >> 1 == bignum("0xbfffffffffffffff", is_unsigned(), 65));
+	assert(-bignum(1, is_signed(), 65) >> 1 == bignum("0x1ffffffffffffffff", is_signed(), 65));
+	assert(bignum("0x17fffffffffffffff", is_signed(), 65) >> 1 == bignum("0x1bfffffffffffffff", is_signed(), 65));
+	assert(s65 >> 1 == bignum("0x7fffffffffffffff", is_signed(), 65) && u65 == bignum("0xffffffffffffffff"));
+	assert(-bignum(1, is_unsigned(), 65) >> 1 == u65);
+	assert(-bignum(1, is_unsigned(), 65) >> 2 == bignum("0x7fffffffffffffff", is_unsigned(), 65));
+	assert(-bignum(1, is_unsigned(), 65) << 1 == bignum("0x1fffffffffffffffe", is_unsigned(), 65));
+	assert(-bignum(1, is_unsigned(), 65) << 2 == bignum("0x1fffffffffffffffc", is_unsigned(), 65));
 
 	/* unsigned comparison */
 	assert(bignum(-1, is_unsigned(), 32) > bignum(1, is_unsigned(), 32));
@@ -248,6 +407,21 @@ void test_bignum()
 	assert(bignum(5).num_bits() == 3);
 	assert(bignum(6).num_bits() == 3);
 	assert(bignum(7).num_bits() == 3);
+
+	/* inline limb storage */
+	{
+		bignum b44("0xfedcba98765432100123456789abcdef"), b45 = b44 * b44;
+		assert(b44.limbs.is_inline() && b45.limbs.is_inline());
+		bignum b46 = b45 * b45, b47 = b46;
+		assert(!b46.limbs.is_inline() && b47 == b46);
+		bignum b48 = std::move(b46);
+		assert(!b48.limbs.is_inline() && b48 == b47);
+		b48 = b48 % b44;
+		assert(b48 == b47 % b44);
+		b45 = std::move(b44);
+		assert(b45.limbs.is_inline() && b45 == bignum("0xfedcba98765432100123456789abcdef"));
+		assert((b47 << 1000) >> 1000 == b47);
+	}
 }
 
 void test_uint8()
@@ -315,9 +489,294 @@ void test_uint64()
 	printf("b3=%s (%s)\n", b3.to_string(10).c_str(), b3.to_string(16).c_str());
 }
 
+static size_t counted_bytes = 0, counted_allocs = 0;
+
+static void* counting_alloc(size_t size)
+{
+	counted_bytes += size;
+	counted_allocs++;
+	return ::operator new(size);
+}
+
+static void counting_free(void *p, size_t size)
+{
+	counted_bytes -= size;
+	::operator delete(p);
+}
+
+void test_memory()
+{
+	/* memory functions */
+	bignum::alloc_func af;
+	bignum::free_func ff;
+	bignum::set_memory_functions(counting_alloc, counting_free);
+	{
+		bignum b1 = bignum(7).pow(1000);
+		assert(counted_bytes >= b1.num_limbs() * sizeof(bignum::ulimb_t));
+		bignum::get_memory_functions(&af, &ff);
+		assert(af == counting_alloc && ff == counting_free);
+	}
+	assert(counted_bytes == 0);
+
+	/* blocks return to the free function they were allocated with */
+	{
+		bignum::set_memory_functions(nullptr, nullptr);
+		bignum h1 = bignum(7).pow(500);
+		bignum::set_memory_functions(counting_alloc, counting_free);
+		bignum c1 = bignum(7).pow(500);
+		size_t n1 = counted_bytes;
+		h1 = bignum(0);
+		assert(counted_bytes == n1 && n1 > 0);
+		{
+			bignum_arena a1(1024);
+			bignum c2 = bignum(7).pow(600);
+			assert(counted_bytes > n1 && a1.owns(c2.limbs.data()));
+			bignum::set_memory_functions(nullptr, nullptr);
+		}
+		assert(counted_bytes == n1);
+		c1 = bignum(0);
+		bignum::set_memory_functions(counting_alloc, counting_free);
+	}
+	assert(counted_bytes == 0);
+
+	/* chained expressions allocate once for the first copy */
+	{
+		bignum a = bignum(7).pow(400), b = bignum(11).pow(300), c = bignum(13).pow(250);
+		size_t n0 = counted_allocs;
+		bignum d = a + b + c;
+		size_t n1 = counted_allocs;
+		bignum e = ((a << 100) | b) ^ c;
+		size_t n2 = counted_allocs;
+		bignum f = (a - b - c) >> 7;
+		size_t n3 = counted_allocs;
+		bignum g = ~a & b;
+		size_t n4 = counted_allocs;
+		assert(n1 - n0 == 1 && n2 - n1 == 1 && n3 - n2 == 1 && n4 - n3 == 1);
+		bignum t = a;
+		assert(d - c - b == a && e == (((t <<= 100) |= b) ^= c));
+		t = a;
+		assert(f == (((t -= b) -= c) >>= 7) && g == ((t = a, t = ~t) &= b));
+		n0 = counted_allocs;
+		bignum h = a, i = std::move(h);
+		assert(i == a && h == 0 && counted_allocs - n0 == 1);
+		i = (i * b + c) % b;
+		assert(i == c && (a * b + c) / b == a);
+	}
+	bignum::set_memory_functions(nullptr, nullptr);
+	bignum::get_memory_functions(&af, &ff);
+	assert(af != counting_alloc && ff != counting_free);
+
+	/* arena with results copied to the heap */
+	bignum b2, b3 = bignum(3).pow(2000);
+	{
+		bignum_arena arena(4096);
+		bignum b4 = bignum(3).pow(1000);
+		bignum b5 = b4 * b4;
+		assert(arena.owns(b5.limbs.data()) && !arena.owns(b3.limbs.data()));
+		assert(arena.chunk_bytes() >= 4096);
+		{
+			bignum_arena::heap_scope heap;
+			b2 = b5;
+			assert(!arena.owns(b2.limbs.data()));
+		}
+		b3 = bignum(0);
+	}
+	assert(b2 == bignum(3).pow(2000) && b2.to_string().size() == 955);
+
+	/* nested arenas and a caller buffer */
+	{
+		alignas(16) static char buf[1 << 16];
+		bignum_arena outer(buf, sizeof(buf));
+		bignum b6 = bignum(5).pow(500), *b7 = new bignum(b6 * b6);
+		assert(outer.owns(b7->limbs.data()));
+		{
+			bignum_arena inner;
+			bignum b8 = *b7 * b6;
+			assert(inner.owns(b8.limbs.data()) && b8 == bignum(5).pow(1500));
+			delete b7;
+		}
+		assert(outer.owns(b6.limbs.data()) && outer.chunk_bytes() == 0);
+		assert(b6 == bignum(5).pow(500));
+	}
+}
+
+void test_expr()
+{
+	bignum a = bignum(7).pow(300), b = bignum(11).pow(200), c = bignum(13).pow(150);
+	bignum d = bignum(3).pow(100), m = bignum(5).pow(250) + 2;
+	bignum x = (bignum(1) << 3000) - 1, y = (bignum(1) << 2500) - 3;
+
+	/* fused shapes match the eager operators */
+	bignum r1 = a.lazy() * b + c, r2 = c + a.lazy() * b, r3 = a.lazy() * b + c.lazy() * d;
+	assert(r1 == a * b + c && r2 == r1 && r3 == a * b + c * d);
+	bignum r4 = a.lazy() * b - c.lazy() * d, r5 = a * b * d - a.lazy() * b;
+	assert(r4 == a * b - c * d && r5 == a * b * d - a * b);
+	bignum r6 = a.lazy() * b % m, r7 = a.lazy() * a % m, r8 = x.lazy() * y % m;
+	assert(r6 == a * b % m && r7 == a * a % m && r8 == x * y % m);
+	assert(bignum(a.lazy() * b % bignum(97)) == a * b % bignum(97));
+	assert(bignum(a.lazy() * b % (a * b * 2)) == a * b);
+	bignum r9 = (a.lazy() << 77) | b, r10 = (a.lazy() << 64) | c;
+	assert(r9 == ((a << 77) | b) && r10 == ((a << 64) | c));
+	bignum r11 = x.lazy() * y + a, r12 = x * y * 2 - x.lazy() * y;
+	assert(r11 == x * y + a && r12 == x * y);
+
+	/* nested and generic shapes */
+	bignum r13 = (a.lazy() + b) * c + d, r14 = a.lazy() * b * c % m, r15 = a.lazy() - b;
+	assert(r13 == (a + b) * c + d && r14 == a * b * c % m && r15 == a - b);
+
+	/* outputs aliasing operands */
+	bignum r16 = c;
+	r16 = a.lazy() * b + r16;
+	assert(r16 == a * b + c);
+	r16 = r16.lazy() * b + c;
+	assert(r16 == (a * b + c) * b + c);
+	r16 = a;
+	r16 = r16.lazy() * r16 % m;
+	assert(r16 == a * a % m);
+	r16 = a;
+	r16 = (r16.lazy() << 5) | r16;
+	assert(r16 == ((a << 5) | a));
+
+	/* fixed width operands use the eager operators */
+	bignum f1(0x12345678, is_unsigned(), 32), f2(0x9abcdef0, is_unsigned(), 32);
+	bignum r17 = f1.lazy() * f2 + f1;
+	assert(r17 == f1 * f2 + f1 && r17.bits == 32);
+
+	/* evaluation into existing storage allocates only scratch */
+	bignum::set_memory_functions(counting_alloc, counting_free);
+	{
+		size_t n0 = counted_allocs;
+		r1 = a.lazy() * b + c;
+		r9 = (a.lazy() << 77) | b;
+		size_t n1 = counted_allocs;
+		r6 = a.lazy() * b % m;
+		size_t n2 = counted_allocs;
+		assert(n1 == n0 && n2 - n1 == 1);
+		assert(r1 == a * b + c && r9 == ((a << 77) | b) && r6 == a * b % m);
+	}
+	bignum::set_memory_functions(nullptr, nullptr);
+}
+
+void test_scalar()
+{
+	bignum a = bignum(7).pow(100), b = bignum(10).pow(40);
+
+	/* integer operands match the bignum operators */
+	assert(a + 1 == a + bignum(1) && a - 1 == a - bignum(1) && a * 10 == a * bignum(10));
+	assert(a / 7 == bignum(7).pow(99) && a % 7 == 0 && (a + 3) % 7 == 3);
+	assert(b * 12345678901234567ull == b * bignum("12345678901234567"));
+	assert(b / 10000000000000000000ull == bignum(10).pow(21) && b % 999999999989ull == 13310000);
+	assert(bignum("18446744073709551615") == UINT64_MAX && (bignum(1) << 64) > UINT64_MAX);
+	assert(bignum(5) == 5u && bignum(5) < 6 && bignum(5) >= 5 && a.compare(0) > 0);
+
+	/* compound and rvalue forms */
+	bignum c = a;
+	c *= 3;
+	c += 2;
+	c -= 1;
+	c /= 3;
+	assert(c == a);
+	c %= 1000;
+	assert(c == a % bignum(1000));
+	assert(bignum(a) * 3 + 2 == a * bignum(3) + bignum(2));
+
+	/* negative operands subtract and negate */
+	assert(a + -5 == a - 5 && a - -5 == a + 5 && bignum(3) > -1);
+	bignum s(100, is_signed(), 64);
+	assert(s * -3 == -bignum(300, is_signed(), 64) && s / -7 == -bignum(14, is_signed(), 64));
+	assert(s - 101 == -1 && s - 200 < -50 && s - 101 > -2);
+	bignum v5(5), v7 = (bignum(1) << 70) + 9;
+	v5 *= -3;
+	assert(v5 == bignum(0) - bignum(15) && bignum(5) * -3 == v5 && bignum(5) - 20 == v5);
+	assert(v7 / -3 == bignum(0) - v7 / 3 && v7 * -1 == bignum(0) - v7 && bignum(0) * -4 == 0);
+	bignum i8(-3, is_signed(), 8);
+	assert(i8 == -3 && i8 < 0 && i8 < 250 && i8 > -4 && !(i8 >= 0));
+	assert(bignum(253, is_unsigned(), 8) > 0 && s - 101 < 0);
+	bignum m16 = bignum(-100, is_signed(), 16) % 7, n16 = bignum(-100, is_signed(), 16);
+	n16 %= 7;
+	assert(m16 == n16 && m16.s.is_signed && m16.bits == 16 && n16.bits == 16);
+
+	/* fixed width wraps at the width */
+	assert(bignum(0x7fffffff, is_unsigned(), 31) + 2 == 1);
+	assert(bignum(1, is_unsigned(), 40) - 2 == bignum("0xffffffffff"));
+	assert(bignum(0x12345678, is_unsigned(), 32) * 0x100 == 0x34567800);
+	bignum u8(200, is_unsigned(), 8), u9 = u8;
+	u9 += bignum(100);
+	assert(u8 + 100 == 44 && u8 + bignum(100) == 44 && u9 == 44);
+
+	/* integer operands allocate only their result */
+	bignum d = bignum(7).pow(1000);
+	bignum::set_memory_functions(counting_alloc, counting_free);
+	{
+		size_t n0 = counted_allocs;
+		d += 1;
+		d -= 1;
+		d *= 10;
+		d /= 10;
+		bool small = d % 7 == 0 && d > 1000;
+		size_t n1 = counted_allocs;
+		bignum e = d * 10 + 1;
+		size_t n2 = counted_allocs;
+		assert(small && n1 == n0 && n2 - n1 == 1);
+		assert(e == d * bignum(10) + bignum(1));
+	}
+	bignum::set_memory_functions(nullptr, nullptr);
+}
+
+void test_mpn()
+{
+	/* dispatched kernels carry through all ones limbs */
+	const mpn_ops<uint64_t> &ops = mpn_ops<uint64_t>::get();
+	uint64_t r[3] = { ~0ull, ~0ull, ~0ull }, a[3] = { ~0ull, ~0ull, ~0ull };
+	assert(ops.addmul_1(r, a, 3, ~0ull) == ~0ull);
+	assert(r[0] == 0 && r[1] == ~0ull && r[2] == ~0ull);
+	assert(ops.submul_1(r, a, 3, ~0ull) == ~0ull);
+	assert(r[0] == ~0ull && r[1] == ~0ull && r[2] == ~0ull);
+	assert(ops.mul_1(r, a, 2, 2) == 1);
+	assert(r[0] == ~1ull && r[1] == ~0ull);
+	assert(ops.add_n(r, r, a, 3) == 1);
+	assert(r[0] == ~2ull && r[1] == ~0ull && r[2] == ~0ull);
+
+	/* single limb division with normalized and unnormalized divisors */
+	uint64_t q[3];
+	assert(mpn<uint64_t>::divrem_1(q, a, 3, 10) == 5);
+	assert(q[0] == 0x9999999999999999ull && q[1] == 0x9999999999999999ull && q[2] == 0x1999999999999999ull);
+	assert(mpn<uint64_t>::divrem_1(q, a, 2, ~0ull) == 0);
+	assert(q[0] == 1 && q[1] == 1);
+
+	bignum b1("123456789012345678901234567890123456789"), b2;
+	assert(bignum::divrem_1(b1, 1000000000, b2) == 123456789);
+	assert(b2 == bignum("123456789012345678901234567890"));
+	assert(bignum::divrem_1(b2, 0x80000001, b2) == (b1 / 1000000000 % bignum(0x80000001)).limb_at(0));
+	assert(b2 == b1 / 1000000000 / bignum(0x80000001));
+
+	/* division by zero matches divrem: zero quotient, dividend remainder */
+	bignum q0, r0;
+	bignum::divrem(b1, bignum(0), q0, r0);
+	assert(b1 / 0 == q0 && b1 % 0 == r0 && q0 == 0 && r0 == b1);
+	b2 = b1;
+	b2 %= 0;
+	assert(b2 == b1);
+	b2 /= 0;
+	assert(b2 == 0);
+
+	/* eight digit decimal chunks */
+	char d8[8];
+	assert(mpn<uint64_t>::unpack_dec_8(mpn<uint64_t>::load_8("01234567")) == 1234567);
+	assert(mpn<uint64_t>::unpack_dec_8(mpn<uint64_t>::load_8("99999999")) == 99999999);
+	mpn<uint64_t>::store_8(d8, mpn<uint64_t>::pack_dec_8(9070605));
+	assert(memcmp(d8, "09070605", 8) == 0);
+	mpn<uint64_t>::store_8(d8, mpn<uint64_t>::pack_dec_8(99999999));
+	assert(memcmp(d8, "99999999", 8) == 0);
+}
+
 int main(int argc, char const *argv[])
 {
 	test_bignum();
+	test_memory();
+	test_expr();
+	test_scalar();
+	test_mpn();
 	test_uint8();
 	test_uint16();
 	test_uint32();
@@ -3,6 +3,7 @@
 #include <cassert>
 #include <cstdlib>
 #include <cinttypes>
+#include <sstream>
 
 #include "wideint.h"
 #include "bignum.h"
@@ -128,6 +129,15 @@ void test_shift_256()
     ASSERT_EQ_256(b,0x201f1e1d1c1b1a19ull,0x1817161514131211ull,0x100f0e0d0c0b0a09ull,0x0807060504030201ull);
 }
 
+void test_add_sub()
+{
+    /* carry and borrow through an all ones limb */
+    uint256_t a = uint256_t{0x1ull,0x5ull} + uint256_t{0xffffffffffffffffull,0xffffffffffffffffull};
+    ASSERT_EQ_256(a,0x0000000000000000ull,0x0000000000000001ull,0x0000000000000005ull,0x0000000000000000ull);
+    uint256_t b = a - uint256_t{0xffffffffffffffffull,0xffffffffffffffffull};
+    ASSERT_EQ_256(b,0x0000000000000000ull,0x0000000000000000ull,0x0000000000000005ull,0x0000000000000001ull);
+}
+
 void test_multiply()
 {
     /* bignum multiplication */
@@ -155,6 +165,37 @@ void test_multiply()
     assert(w16.to_string() == "452312847740768055613344954116656535546982460631814466461259655922420023296");
     uint256_t w17 = uint256_t{0,0x1} * uint256_t(0x10000000);
     assert(w17 == (uint256_t{0,0x10000000}));
+
+    /* truncation to the width */
+    uint256_t w18 = uint256_t{~0ull,~0ull,~0ull,~0ull} * uint256_t{~0ull,~0ull,~0ull,~0ull};
+    assert(w18 == 1);
+    assert((wideint<64,false>(0xfedcba9876543210ull) * wideint<64,false>(0x123456789ull)) == 0xcccccccce1833a90ull);
+    assert(int48_t(0x123456789abull) * int48_t(0x1000) == 0x3456789ab000ull);
+    assert((wideint<128,false,32>{0xffffffff,0xffffffff} * wideint<128,false,32>{0xffffffff,0xffffffff})
+        == (wideint<128,false,32>{1,0,0xfffffffe,0xffffffff}));
+}
+
+void test_divide()
+{
+    /* single limb divisors */
+    uint128_t w1 = uint128_t{0x123456789abcdef0ull,0xfedcba9876543210ull};
+    assert((w1 / uint128_t(10)) == (uint128_t{0x01d208a5a912e318ull,0x197c790f3f086b68ull}));
+    assert(w1 % uint128_t(10) == 0);
+    assert(uint256_t(12345) / uint256_t(0) == 0 && uint256_t(12345) % uint256_t(0) == 12345);
+
+    /* normalized divisors with the top bit set */
+    uint128_t w2 = uint128_t{0,0x8000000000000000ull};
+    assert((w2 / uint128_t{1,0x8000000000000000ull}) == 0);
+    assert((w2 / uint128_t{0,0x4000000000000000ull}) == 2);
+    assert((uint128_t{~0ull,~0ull} % uint128_t{~0ull,0x8000000000000000ull}) == (uint128_t{0,0x7fffffffffffffffull}));
+
+    /* 32-bit limbs and a single limb width */
+    typedef wideint<128,false,32> uint128x32_t;
+    uint128x32_t w3 = uint128x32_t{0,0,0,0x80000000};
+    assert((w3 / uint128x32_t{0,0x80000000}) == (uint128x32_t{0,0,0x1}));
+    assert((w3 % uint128x32_t{3}) == 2);
+    assert(int48_t(0x123456789abull) / int48_t(0x1000) == 0x12345678ull);
+    assert(int48_t(0x123456789abull) % int48_t(0x1000) == 0x9abull);
 }
 
 void test_clz()
@@ -198,6 +239,36 @@ void test_string()
     assert(int256_t("0xff") == 0xff);
     assert(int256_t("0x807060504030201") == (int256_t{0x0807060504030201ull}));
     assert(int256_t("0x100f0e0d0c0b0a090807060504030201") == (int256_t{0x0807060504030201ull,0x100f0e0d0c0b0a09ull}));
+    assert(int256_t("0xFEDCBA9876543210fedcba98") == (int256_t{0x76543210fedcba98ull,0xfedcba98ull}));
+    assert(int256_t("0x1" + std::string(64, '0')) == 0);
+    assert(int256_t("0b" + std::string(70, '1')) == (int256_t{~0ull,0x3full}));
+
+    std::ostringstream os;
+    os << int256_t("123456789012345678901234567890");
+    assert(os.str() == "123456789012345678901234567890");
+
+    uint256_t m = uint256_t(0) - uint256_t(1);
+    assert(m.to_string() == "115792089237316195423570985008687907853269984665640564039457584007913129639935");
+    assert(uint256_t(10).pow(19).to_string() == "1" + std::string(19, '0'));
+    assert(uint256_t(10).pow(38).to_string() == "1" + std::string(38, '0'));
+    assert((uint256_t(10).pow(57) + 7).to_string() == "1" + std::string(56, '0') + "7");
+    assert(uint256_t(0).to_string() == "0");
+
+    char buf[int256_t::max_chars];
+    for (size_t radix : {2, 10, 16}) {
+        int256_t v = int256_t("0x807060504030201");
+        std::string s = v.to_string(radix);
+        assert(v.to_chars_size(radix) == s.size());
+        assert(v.to_chars(buf, buf + s.size() - 1, radix) == nullptr);
+        char *end = v.to_chars(buf, buf + s.size(), radix);
+        assert(end == buf + s.size() && std::string(buf, end) == s);
+    }
+
+    int256_t v;
+    const char *str = "0x00ff 12345678901234567890123";
+    assert(v.from_chars(str, str + 30) == str + 6 && v == 0xff);
+    assert(v.from_chars(str + 7, str + 30) == str + 30 && v.to_string() == "12345678901234567890123");
+    assert(v.from_chars(str + 6, str + 30) == nullptr);
 }
 
 int main(int argc, char const *argv[])
@@ -206,7 +277,9 @@ int main(int argc, char const *argv[])
     test_i256<int256_t>();
     test_mask_48();
     test_shift_256();
+    test_add_sub();
     test_multiply();
+    test_divide();
     test_clz();
     test_ctz();
     test_string();